@@ -28,6 +28,14 @@
 /* STD */
 #include <string>
 #include <map>
+#include <list>
+#include <vector>
+
+/* BOOST */
+#include <boost/unordered_map.hpp>
+#include <boost/function.hpp>
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
 
 /* Matrix */
 #include <jrl/mal/boost.hh>
@@ -48,6 +56,10 @@ namespace djj = dynamicsJRLJapan;
 #include <dynamic-graph/signal-time-dependent.h>
 #include <sot/core/exception-dynamic.hh>
 #include <sot/core/matrix-homogeneous.hh>
+#include <sot-dynamic/sparse-jacobian.h>
+#include <sot-dynamic/inertia-factorization.h>
+#include <sot-dynamic/spatial-algebra.h>
+#include <sot-dynamic/matrix-inertia.h>
 
 /* --------------------------------------------------------------------- */
 /* --- API ------------------------------------------------------------- */
@@ -67,6 +79,10 @@ namespace djj = dynamicsJRLJapan;
 namespace dynamicgraph { namespace sot {
 namespace dg = dynamicgraph;
 
+  class RigidBodyTree;
+  class SignalWorkerPool;
+  struct ModelDescription;
+
   namespace command {
     class SetFiles;
     class Parse;
@@ -109,6 +125,10 @@ class SOTDYNAMIC_EXPORT Dynamic
   CjrlHumanoidDynamicRobot* m_HDR;
 
 
+  /*! \brief Legacy mode: if nonzero, the rows and columns of the dofs
+    locked by setActiveDofs are replaced by identity ones in inertia.
+    The command debugInertia sets the mask of the HRP-2 model while the
+    mode is on, and restores the previous one when it is switched off. */
   int debugInertia;
 
   /*! \brief Fields to access the humanoid model
@@ -129,6 +149,21 @@ class SOTDYNAMIC_EXPORT Dynamic
   /*! @} */
   bool init;
   std::list< dg::SignalBase<int>*  > genericSignalRefs;
+  /*! \brief Position of each generic signal in genericSignalRefs, by the
+    name given at creation. */
+  typedef std::list< dg::SignalBase<int>* >::iterator GenericSignalHandle;
+  boost::unordered_map<std::string,GenericSignalHandle> genericSignalIndex_;
+  /*! \brief Joint of a jacobian drift signal and its index in the
+    kinematic tree, resolved again only when the tree is rebuilt. */
+  struct DriftTarget
+  {
+    std::string signame;
+    CjrlJoint* joint;
+    int index;
+    unsigned int treeBuild;
+  };
+  /// Bound to the drift signals, which keeps their address.
+  std::list<DriftTarget> driftTargets_;
 
  public: /* --- CONSTRUCTION --- */
 
@@ -145,6 +180,13 @@ class SOTDYNAMIC_EXPORT Dynamic
   void setXmlRankFile( const std::string& filename );
   void parseConfigFiles( void );
 
+  /*! \brief Directory of the binary cache of the parsed models, see
+    parseConfigFiles, created on the first parse. Empty to disable the
+    cache. The default is $SOT_DYNAMIC_MODEL_CACHE if set,
+    $XDG_CACHE_HOME/sot-dynamic or $HOME/.cache/sot-dynamic otherwise. */
+  void setModelCacheDirectory( const std::string& directory );
+  std::string getModelCacheDirectory( void ) const;
+
  public: /* --- SIGNAL ACTIVATION --- */
   dg::SignalTimeDependent< ml::Matrix,int > &
     createEndeffJacobianSignal( const std::string& signame,
@@ -153,6 +195,25 @@ class SOTDYNAMIC_EXPORT Dynamic
     createJacobianSignal( const std::string& signame,
 			  CjrlJoint* inJoint );
   void destroyJacobianSignal( const std::string& signame );
+  /*! \brief Create the position signal <name> and the end-effector
+    jacobian signal J<name> of several operational points, as
+    createOpPoint does for each of them. */
+  void createOpPointSignals( const std::vector<std::string>& opPointNames,
+			     const std::vector<CjrlJoint*>& joints );
+  dg::SignalTimeDependent< SparseJacobian,int > &
+    createSparseJacobianSignal( const std::string& signame,
+				CjrlJoint* inJoint );
+  void destroySparseJacobianSignal( const std::string& signame );
+  /*! \brief Create the center of mass signal <name> and its jacobian
+    J<name> for the bodies of the subtrees rooted at the given joints. */
+  void createSubtreeComSignals( const std::string& name,
+				const std::vector<CjrlJoint*>& roots );
+  void destroySubtreeComSignals( const std::string& name );
+  /*! \brief Create a signal keeping the active dof columns of the
+    jacobian signal named jacobianName (see setActiveDofs). */
+  dg::SignalTimeDependent< ml::Matrix,int > &
+    createReducedJacobianSignal( const std::string& signame,
+				 const std::string& jacobianName );
   dg::SignalTimeDependent< MatrixHomogeneous,int >&
     createPositionSignal( const std::string& signame,
 			  CjrlJoint* inJoint );
@@ -165,6 +226,15 @@ class SOTDYNAMIC_EXPORT Dynamic
     createAccelerationSignal( const std::string& signame,
 			     CjrlJoint* inJoint );
   void destroyAccelerationSignal( const std::string& signame );
+  /*! \brief Create the signal dJ/dt.dq of the end-effector jacobian of
+    the joint (the jacobian of createOpPoint): J.ddq + dJ/dt.dq is the
+    linear acceleration of the joint origin and the angular acceleration,
+    in the joint frame. All these signals read the velocity pass of the
+    tree, computed once per time. */
+  dg::SignalTimeDependent< ml::Vector,int >&
+    createJacobianDriftSignal( const std::string& signame,
+			       CjrlJoint* inJoint );
+  void destroyJacobianDriftSignal( const std::string& signame );
 
   bool zmpActivation( void ) { std::string Property("ComputeZMP");
     std::string Value; m_HDR->getProperty(Property,Value); return (Value=="true");}
@@ -183,28 +253,81 @@ class SOTDYNAMIC_EXPORT Dynamic
   dg::SignalPtr<ml::Vector,int> freeFlyerVelocitySIN;
   dg::SignalPtr<ml::Vector,int> jointAccelerationSIN;
   dg::SignalPtr<ml::Vector,int> freeFlyerAccelerationSIN;
+  /*! \brief Joint torques of forwardDynamicsSOUT, of the size of the
+    configuration or of the actuated joints only (the free-flyer is then
+    not actuated). */
+  dg::SignalPtr<ml::Vector,int> jointTorqueSIN;
 
   // protected:
  public:
   typedef int Dummy;
+
+  /*! \brief Order of the quantities computed by a forward kinematics
+    stage: geometry only, first-order or second-order quantities. */
+  enum KinematicsOrder
+  {
+    POSITION_ORDER=0,
+    VELOCITY_ORDER=1,
+    ACCELERATION_ORDER=2
+  };
+
   dg::SignalTimeDependent<Dummy,int> firstSINTERN;
+  /*! \brief Geometric stage: depends on the position inputs only. */
+  dg::SignalTimeDependent<Dummy,int> kinematicsSINTERN;
+  /*! \brief First-order stage: depends on the position and velocity
+    inputs. */
+  dg::SignalTimeDependent<Dummy,int> velocityKinematicsSINTERN;
+  /*! \brief Full stage: depends on all the inputs. */
   dg::SignalTimeDependent<Dummy,int> newtonEulerSINTERN;
-
+  /*! \brief Centers of mass and their jacobians, for the whole body and
+    the subtrees, computed in one pass over the tree. */
+  dg::SignalTimeDependent<Dummy,int> comSINTERN;
+  /*! \brief Forward pass of the body velocities over the tree, shared by
+    the recursive algorithms that need the velocities. */
+  dg::SignalTimeDependent<Dummy,int> treeVelocitySINTERN;
+
+  int& computeKinematics( int& dummy,int time );
+  int& computeVelocityKinematics( int& dummy,int time );
   int& computeNewtonEuler( int& dummy,int time );
   int& initNewtonEuler( int& dummy,int time );
+  int& computeTreeVelocity( int& dummy,int time );
+
+  /*! \brief Copy the inputs at time \a time up to the given order into
+    the persistent staging buffers, apply the free-flyer overrides in
+    place and hand the buffers to m_HDR.
+    Once the buffers have been sized by a first call, this does not
+    allocate any memory. */
+  void stageState( int time,KinematicsOrder order=ACCELERATION_ORDER );
+
+  /*! \name Persistent staging buffers of the state handed to m_HDR.
+    They are resized only when the dimension of the inputs changes.
+    @{ */
+  ml::Vector positionBuffer_;
+  ml::Vector velocityBuffer_;
+  ml::Vector accelerationBuffer_;
+  ml::Vector torqueBuffer_;
+  /*! @} */
 
  public:
   dg::SignalTimeDependent<ml::Vector,int> zmpSOUT;
   dg::SignalTimeDependent<ml::Matrix,int> JcomSOUT;
   dg::SignalTimeDependent<ml::Vector,int> comSOUT;
   dg::SignalTimeDependent<ml::Matrix,int> inertiaSOUT;
+  /// The inertia matrix in the layout set by setInertiaLayout.
+  dg::SignalTimeDependent<ml::Matrix,int> inertiaPackedSOUT;
 
   dg::SignalTimeDependent<ml::Matrix,int>& jacobiansSOUT( const std::string& name );
+  dg::SignalTimeDependent<SparseJacobian,int>& sparseJacobiansSOUT( const std::string& name );
   dg::SignalTimeDependent<MatrixHomogeneous,int>& positionsSOUT( const std::string& name );
   dg::SignalTimeDependent<ml::Vector,int>& velocitiesSOUT( const std::string& name );
   dg::SignalTimeDependent<ml::Vector,int>& accelerationsSOUT( const std::string& name );
 
   dg::SignalTimeDependent<double,int> footHeightSOUT;
+  /*! \brief Bounds of all the dofs, one row per kind: lower and upper
+    position, velocity and torque bounds, in this order. The bound
+    outputs are rows of this matrix. They are computed once and only
+    recomputed after an edition of the model, see invalidateLimits. */
+  dg::SignalTimeDependent<ml::Matrix,int> limitsSOUT;
   dg::SignalTimeDependent<ml::Vector,int> upperJlSOUT;
   dg::SignalTimeDependent<ml::Vector,int> lowerJlSOUT;
   dg::SignalTimeDependent<ml::Vector,int> upperVlSOUT;
@@ -218,6 +341,36 @@ class SOTDYNAMIC_EXPORT Dynamic
   dg::SignalTimeDependent<ml::Vector,int> MomentaSOUT;
   dg::SignalTimeDependent<ml::Vector,int> AngularMomentumSOUT;
   dg::SignalTimeDependent<ml::Vector,int> dynamicDriftSOUT;
+  /*! \brief Centroidal momentum matrix: the linear and angular momentum
+    at the center of mass (same order as momenta) are Ag.dq. */
+  dg::SignalTimeDependent<ml::Matrix,int> AgSOUT;
+  /*! \brief dAg/dt.dq, the derivative of the centroidal momentum at zero
+    joint acceleration. */
+  dg::SignalTimeDependent<ml::Vector,int> dAgvSOUT;
+  /*! \brief Joint torques g(q) compensating the gravity. Only depends on
+    the position. */
+  dg::SignalTimeDependent<ml::Vector,int> gravityTorqueSOUT;
+  /*! \brief Joint torques C(q,dq).dq + g(q), i.e. dynamicDrift without
+    the acceleration input. */
+  dg::SignalTimeDependent<ml::Vector,int> nonlinearEffectsSOUT;
+  /*! \brief Joint accelerations M^-1.(torque - C(q,dq).dq - g(q))
+    produced by the torque input, computed in O(n) without forming nor
+    inverting the inertia matrix. */
+  dg::SignalTimeDependent<ml::Vector,int> forwardDynamicsSOUT;
+  /*! \brief Sparse inertia matrix and its L'.D.L factorization along
+    the tree, with the solvers (M^-1.x, L^-T.J'...) to use instead of a
+    dense inverse of inertia. */
+  dg::SignalTimeDependent<InertiaFactorization,int> inertiaFactorizationSOUT;
+  /*! \brief dJcom/dt.dq: Jcom.ddq + dJcomv is the acceleration of the
+    center of mass. */
+  dg::SignalTimeDependent<ml::Vector,int> dJcomvSOUT;
+
+  /*! \name Outputs restricted to the active dofs (see setActiveDofs).
+    @{ */
+  dg::SignalTimeDependent<ml::Matrix,int> inertiaReducedSOUT;
+  dg::SignalTimeDependent<ml::Matrix,int> JcomReducedSOUT;
+  dg::SignalTimeDependent<ml::Vector,int> dynamicDriftReducedSOUT;
+  /*! @} */
 
  protected:
   ml::Vector& computeZmp( ml::Vector& res,int time );
@@ -226,14 +379,54 @@ class SOTDYNAMIC_EXPORT Dynamic
   ml::Matrix& computeJcom( ml::Matrix& res,int time );
   ml::Vector& computeCom( ml::Vector& res,int time );
   ml::Matrix& computeInertia( ml::Matrix& res,int time );
+  ml::Matrix& computeInertiaPacked( ml::Matrix& res,int time );
   ml::Matrix& computeInertiaReal( ml::Matrix& res,int time );
+  ml::Matrix& computeAg( ml::Matrix& res,int time );
+  ml::Vector& computeAgDrift( ml::Vector& res,int time );
+  ml::Vector& computeGravityTorque( ml::Vector& res,int time );
+  ml::Vector& computeNonlinearEffects( ml::Vector& res,int time );
+  ml::Vector& computeForwardDynamics( ml::Vector& res,int time );
+  InertiaFactorization& computeInertiaFactorization( InertiaFactorization& res,
+						     int time );
+  ml::Vector& computeJcomDrift( ml::Vector& res,int time );
   double& computeFootHeight( double& res,int time );
 
   ml::Matrix& computeGenericJacobian( CjrlJoint* j,ml::Matrix& res,int time );
   ml::Matrix& computeGenericEndeffJacobian( CjrlJoint* j,ml::Matrix& res,int time );
+  SparseJacobian& computeGenericSparseJacobian( CjrlJoint* j,SparseJacobian& res,int time );
   MatrixHomogeneous& computeGenericPosition( CjrlJoint* j,MatrixHomogeneous& res,int time );
+  /// Rotation correction of the position output, R_initial', depending
+  /// only on the model. Stored row-major.
+  static void computeFrameCorrection( CjrlJoint* j,double correction[9] );
+  /// res = [ R.correction p ; 0 1 ], with [ R p ; 0 1 ] the transform m4.
+  static void composeJointPosition( const matrix4d& m4,const double correction[9],
+				    MatrixHomogeneous& res );
   ml::Vector& computeGenericVelocity( CjrlJoint* j,ml::Vector& res,int time );
   ml::Vector& computeGenericAcceleration( CjrlJoint* j,ml::Vector& res,int time );
+  ml::Vector& computeGenericJacobianDrift( DriftTarget* target,ml::Vector& res,int time );
+
+  /// \name Calls to jrl-dynamics on the path of the output signals,
+  /// virtual so that they can be instrumented.
+  ///@{
+  /// Forward kinematics of m_HDR, see runForwardKinematics.
+  virtual void computeRobotKinematics( void );
+  /// Jacobian of the joint, see jointJacobian.
+  virtual void computeJointJacobian( CjrlJoint* joint );
+  ///@}
+
+  /// Rows of limitsSOUT.
+  enum LimitRow
+  {
+    LOWER_POSITION_LIMIT=0,
+    UPPER_POSITION_LIMIT,
+    LOWER_VELOCITY_LIMIT,
+    UPPER_VELOCITY_LIMIT,
+    LOWER_TORQUE_LIMIT,
+    UPPER_TORQUE_LIMIT,
+    NB_LIMIT_ROWS
+  };
+  ml::Matrix& computeLimits( ml::Matrix& res,const int& time );
+  ml::Vector& getLimitRow( const LimitRow row,ml::Vector& res,const int& time );
 
   ml::Vector& getUpperJointLimits( ml::Vector& res,const int& time );
   ml::Vector& getLowerJointLimits( ml::Vector& res,const int& time );
@@ -246,13 +439,24 @@ class SOTDYNAMIC_EXPORT Dynamic
 
   ml::Vector& computeTorqueDrift( ml::Vector& res,const int& time );
 
+  ml::Matrix& selectActiveColumns( const ml::Matrix& J,ml::Matrix& res ) const;
+  ml::Matrix& computeInertiaReduced( ml::Matrix& res,int time );
+  ml::Matrix& computeJcomReduced( ml::Matrix& res,int time );
+  ml::Vector& computeTorqueDriftReduced( ml::Vector& res,int time );
+  ml::Matrix& computeReducedJacobian( dg::SignalTimeDependent<ml::Matrix,int>* J,
+				      ml::Matrix& res,int time );
+
  public: /* --- PARAMS --- */
   virtual void commandLine( const std::string& cmdLine,
 			    std::istringstream& cmdArgs,
 			    std::ostream& os );
   void cmd_createOpPointSignals           ( const std::string& sig,const std::string& j );
+  void cmd_createOpPointsSignals          ( const std::string& opPoints );
   void cmd_createJacobianWorldSignal      ( const std::string& sig,const std::string& j );
   void cmd_createJacobianEndEffectorSignal( const std::string& sig,const std::string& j );
+  void cmd_createSparseJacobianSignal     ( const std::string& sig,const std::string& j );
+  void cmd_createReducedJacobianSignal    ( const std::string& sig,const std::string& J );
+  void cmd_createSubtreeComSignals        ( const std::string& sig,const std::string& roots );
   void cmd_createPositionSignal           ( const std::string& sig,const std::string& j );
 
  public:
@@ -362,6 +566,105 @@ class SOTDYNAMIC_EXPORT Dynamic
   /// The robot is assumed to be symmetric.
   ml::Vector getAnklePositionInFootFrame() const;
 
+  /// \brief Get the statistics of the jacobian cache.
+  ///
+  /// \return a vector (number of hits, number of misses).
+  ml::Vector getJacobianCacheStatistics() const;
+
+  /// \brief Reset the statistics of the jacobian cache.
+  void resetJacobianCacheStatistics();
+
+  /// \brief Compute the position and end-effector jacobian signals in
+  /// parallel.
+  ///
+  /// With nbThreads>0, the first of these signals evaluated at a new
+  /// stage computes the others. The calling thread runs jrl-dynamics;
+  /// the per-joint products are spread over nbThreads threads and the
+  /// calling one. 0 (the default) disables it.
+  void setParallelSignals( const unsigned int& nbThreads );
+  unsigned int getParallelSignals() const;
+
+  /// \brief When set, createOpPoint and createOpPoints also create the
+  /// signal dJv<name> of each operational point, see
+  /// createJacobianDriftSignal. Off by default.
+  void setOpPointDrift( const bool& drift );
+  bool getOpPointDrift() const;
+
+  /// \brief Select the active dofs.
+  ///
+  /// \param mask vector of the size of the configuration, 0 for a locked
+  /// dof. An empty mask makes all the dofs active.
+  void setActiveDofs( const ml::Vector& mask );
+  ml::Vector getActiveDofs() const;
+
+  /// \brief Set the tolerance of the inertia cache.
+  ///
+  /// The inertia matrix is recomputed only if a coordinate of the
+  /// configuration differs by more than the tolerance from the one of the
+  /// last computation. 0 (the default) compares exactly.
+  void setInertiaTolerance( const double& tolerance );
+  double getInertiaTolerance() const;
+
+  /// \brief Set the layout of the inertiaPacked output. The inertia
+  /// output is always the full symmetric matrix.
+  ///
+  /// \param layout "dense" (the default, the full matrix), "packedUpper"
+  /// (a column of n(n+1)/2 entries, the upper triangle column by column
+  /// as read by dpptrf) or "lowerColumnMajor" (an n x n matrix whose
+  /// storage is the lower triangle column-major as read by dpotrf: as a
+  /// row-major matrix it only holds the upper triangle).
+  void setInertiaLayout( const std::string& layout );
+  std::string getInertiaLayout() const;
+
+  /// \brief Get the statistics of the inertia cache.
+  ///
+  /// \return a vector (number of hits, number of misses).
+  ml::Vector getInertiaCacheStatistics() const;
+
+  /// \brief Reset the statistics of the inertia cache.
+  void resetInertiaCacheStatistics();
+
+  /// \brief Force the next inertia evaluation to recompute.
+  ///
+  /// Called when the memo policy changes (active dofs, tolerance,
+  /// debugInertia). The model of the tree is kept.
+  void invalidateInertiaCache();
+
+  /// \brief Rebuild the model of the tree and the inertia on next use.
+  ///
+  /// Called on every model edit done through Dynamic; to be called by
+  /// users modifying m_HDR directly.
+  void invalidateModel();
+
+  /// \brief Read the inertias of the bodies again on next use.
+  ///
+  /// Called by setMass, setLocalCenterOfMass and setInertiaMatrix: the
+  /// topology is kept, only the body parameters are read again.
+  void invalidateBodyInertias();
+
+  /// \brief Force the next evaluation of the dof bounds to recompute.
+  ///
+  /// Called by setDofBounds and on changes of the kinematic tree; to be
+  /// called by users modifying the bounds of m_HDR directly.
+  void invalidateLimits();
+
+  /// \brief Inertia matrix at time, without copy.
+  ///
+  /// This is the storage the inertia signals copy from. The reference
+  /// stays valid, but its content changes at the next evaluation at a
+  /// different configuration.
+  const ml::Matrix& inertiaMatrix( int time );
+
+  /// \brief Get the joint metadata table.
+  ///
+  /// \return a matrix with one row per joint, in the order of
+  /// getJointNames: rank in the configuration, number of dofs, and row of
+  /// the parent joint (-1 for the root).
+  ml::Matrix getJointTable();
+
+  /// \brief Get the names of the joints, separated by spaces.
+  std::string getJointNames();
+
   /// @}
   ///
  private:
@@ -371,6 +674,233 @@ class SOTDYNAMIC_EXPORT Dynamic
   /// Return a specific joint, being given a name by string inside a short list.
   CjrlJoint* getJointByName( const std::string& jointName );
 
+  /// \name Generic signal handles.
+  ///@{
+  void registerGenericSignal( const std::string& signame,dg::SignalBase<int>* sig );
+  /// Throw if no generic signal has been created under this name.
+  GenericSignalHandle genericSignalHandle( const std::string& signame,const char* kind );
+  /// Deregister, forget and delete the signal, and the reduced jacobians
+  /// created from it.
+  void releaseGenericSignal( const std::string& signame,GenericSignalHandle handle );
+  /// Source jacobian of each signal created by createReducedJacobian.
+  std::map<std::string,std::string> reducedJacobianSources_;
+  ///@}
+
+  /// \name Parallel computation of the joint signals, see
+  /// setParallelSignals.
+  ///@{
+  struct JointCache;
+  /// Joints of the position and end-effector jacobian signals. The main
+  /// thread computes the stage and the jacobians of jrl-dynamics, and
+  /// copies the joint transformations: the workers then only compose the
+  /// position and end-effector jacobian of one joint in its cache.
+  struct ParallelJoint
+  {
+    CjrlJoint* joint;
+    bool endeff;
+    /// Set by the main thread before each batch.
+    JointCache* cache;
+  };
+  void registerParallelSignal( const std::string& signame,CjrlJoint* joint,
+			       const bool endeff );
+  void buildParallelTasks( void );
+  /// Compute the position and end-effector jacobian of all the joints of
+  /// the signals, once per stage, if the parallel mode is enabled.
+  void prefetchGenericSignals( int time );
+  void runParallelJoint( unsigned int index,int time );
+  /// Joint and kind of each signal, by name.
+  boost::unordered_map< std::string,std::pair<CjrlJoint*,bool> > parallelSignals_;
+  std::vector<ParallelJoint> parallelJoints_;
+  std::vector< boost::function<void (int)> > parallelTasks_;
+  bool parallelTasksReady_;
+  SignalWorkerPool* workerPool_;
+  /// Stage (see stageCount_) of the last batch.
+  unsigned int prefetchStage_;
+  ///@}
+
+  /// See setOpPointDrift.
+  bool opPointDrift_;
+
+  /// \name Joint registry, built from the model when first needed.
+  ///@{
+  struct JointInfo
+  {
+    CjrlJoint* joint;
+    unsigned int rank;
+    unsigned int nbDof;
+    /// Index of the parent joint in jointTable_, -1 for the root.
+    int parent;
+  };
+  /// Joints in the order of m_HDR->jointVector().
+  std::vector<JointInfo> jointTable_;
+  /// Index in jointTable_ of the joints, by name and by special name
+  /// (waist, left-ankle...).
+  boost::unordered_map<std::string,unsigned int> jointIndex_;
+  bool jointRegistryReady_;
+  void buildJointRegistry( void );
+  /// To be called whenever the kinematic tree of m_HDR changes.
+  void invalidateJointRegistry( void );
+  ///@}
+
+  /// \name Forward kinematics stages.
+  ///@{
+  /// Run the stage of given order at time, unless a stage of higher or
+  /// equal order has already been run at that time on the same inputs.
+  /// The first and second orders are raised to the one of the plugged
+  /// inputs, the geometric order is run alone.
+  void computeStage( KinematicsOrder order,int time );
+  /// True if the last stage was run at time, with at least the given
+  /// order, on the current values of the inputs.
+  bool isStageCurrent( KinematicsOrder order,int time );
+  /// Highest order allowed by the plugged inputs.
+  KinematicsOrder pluggedOrder( void ) const;
+  /// Run the forward kinematics of m_HDR, switching off temporarily the
+  /// properties not needed by the stage.
+  void runForwardKinematics( KinematicsOrder order );
+  /// Time and order of the last stage run.
+  int stageTime_;
+  KinematicsOrder stageOrder_;
+  /// Number of stages run on new positions, used to key the per-joint
+  /// cache.
+  unsigned int stageCount_;
+  /// Buffers used to save and restore the properties of m_HDR.
+  std::vector<std::string> stagePropertyNames_;
+  std::vector<std::string> stagePropertyValues_;
+  std::vector<bool> stagePropertySaved_;
+  std::string stagePropertyOff_;
+  ///@}
+
+  /// \name Per-joint cache shared by the position and jacobian signals.
+  ///@{
+  struct JointCache
+  {
+    JointCache();
+    /// Stage (see stageCount_) of the last jacobian computation.
+    unsigned int jacobianStage;
+    /// Stage and value of the last position computation.
+    unsigned int positionStage;
+    MatrixHomogeneous position;
+    /// Stage and value of the last end-effector jacobian, only computed
+    /// in the parallel mode.
+    unsigned int endeffStage;
+    ml::Matrix endeffJacobian;
+    /// Copy of the joint transformation and pointer to the jacobian of
+    /// jrl-dynamics, staged for the workers.
+    matrix4d transformation;
+    const matrixNxP* jacobian;
+    /// See computeFrameCorrection.
+    double correction[9];
+    /// Columns of the configuration on which the joint depends: the dofs
+    /// of the joints from the root to the joint, in increasing order.
+    bool supportReady;
+    std::vector<unsigned int> support;
+    /// Statistics of the jacobian cache, kept per joint since the joints
+    /// can be computed in parallel.
+    unsigned int jacobianHits;
+    unsigned int jacobianMisses;
+  };
+  std::map<CjrlJoint*,JointCache> jointCache_;
+  JointCache& jointCache( CjrlJoint* joint );
+  /// Return the jacobian of the joint wrt the configuration, computing it
+  /// only if it has not been computed yet for the current stage.
+  const matrixNxP& jointJacobian( CjrlJoint* joint );
+  /// Return the position of the joint, computing it only if it has not
+  /// been computed yet for the current stage.
+  const MatrixHomogeneous& jointPosition( CjrlJoint* joint );
+  /// Return the columns of the jacobian of the joint that can be nonzero.
+  const std::vector<unsigned int>& jointSupport( CjrlJoint* joint );
+  /// res = [ R' 0 ; 0 R' ] J on the columns of the support, zero on the
+  /// others, with R the rotation of the position M.
+  static void composeEndeffJacobian( const matrixNxP& J,
+				     const MatrixHomogeneous& M,
+				     const std::vector<unsigned int>& support,
+				     ml::Matrix& res );
+  ///@}
+
+  /// \name Active dofs, see setActiveDofs.
+  ///@{
+  ml::Vector dofMask_;
+  /// Indices of the nonzero entries of dofMask_.
+  std::vector<unsigned int> activeDofs_;
+  /// Mask set by the user, replaced by the one of debugInertia while
+  /// the mode is on.
+  ml::Vector userDofMask_;
+  ///@}
+
+  /// \name Inertia cache, keyed by the staged configuration.
+  ///@{
+  /// Inertia at configuration inertiaKey_, debugInertia applied.
+  ml::Matrix inertiaMemo_;
+  ml::Vector inertiaKey_;
+  bool inertiaMemoValid_;
+  /// Incremented each time inertiaMemo_ changes or is invalidated.
+  unsigned int inertiaMemoVersion_;
+  double inertiaTolerance_;
+  MatrixInertia::Layout inertiaLayout_;
+  unsigned int inertiaMemoHits_;
+  unsigned int inertiaMemoMisses_;
+  /// Composite rigid body algorithm on m_HDR, initialized on first use
+  /// after each model change.
+  MatrixInertia crba_;
+  bool crbaReady_;
+  /// Return crba_ updated to the configuration of time.
+  MatrixInertia& inertiaAlgorithm( int time );
+  /// inertiaReal, with the inertia version and rotor parameters used.
+  ml::Matrix inertiaRealMemo_;
+  unsigned int inertiaRealVersion_;
+  ml::Vector inertiaRealGearRatio_;
+  ml::Vector inertiaRealRotor_;
+  ///@}
+
+  /// \name World-frame image of the kinematic tree, see RigidBodyTree.
+  ///@{
+  RigidBodyTree* tree_;
+  /// Stage (see stageCount_) of the last position update of tree_.
+  unsigned int treePositionStage_;
+  /// Identifies the files the model was parsed from, empty if it was
+  /// built or edited through the commands.
+  std::string modelKey_;
+  std::string modelCacheDirectory_;
+  /// Description of the parsed files, shared with the other entities
+  /// of the process that parse them (see ModelCache::share).
+  boost::shared_ptr<const ModelDescription> sharedDescription_;
+  /// Build the robot from a cached description. Return false, leaving
+  /// the robot half-built, if jrl does not rebuild the same model.
+  bool replayModelDescription( const ModelDescription& model );
+  /// Return the tree with the poses of time, building it if needed.
+  RigidBodyTree& kinematicTree( int time );
+  /// Spatial inertia of the subtree of each body, at the world origin.
+  std::vector<spatial::Inertia> compositeInertia_;
+  /// Structure of inertiaFactorizationSOUT, read from the tree.
+  std::vector<int> factorizationParents_;
+  std::vector<unsigned int> factorizationOrder_;
+  std::vector<int> factorizationLastDof_;
+  ///@}
+
+  /// \name Centers of mass computed by comSINTERN.
+  ///@{
+  struct ComGroup
+  {
+    /// Name of the com signal, empty for the whole body.
+    std::string name;
+    /// Roots of the subtrees, empty for the whole body.
+    std::vector<CjrlJoint*> roots;
+    /// Bodies of the tree belonging to the group.
+    std::vector<bool> member;
+    /// Mass and first moment of the group bodies below each body.
+    std::vector<double> subtreeMass;
+    std::vector<spatial::Vector3> subtreeMoment;
+    ml::Vector com;
+    ml::Matrix Jcom;
+  };
+  /// The whole body comes first.
+  std::list<ComGroup> comGroups_;
+  void updateComGroupMembers( ComGroup& group );
+  int& computeComPass( int& dummy,int time );
+  ml::Vector& computeGroupCom( ComGroup* group,ml::Vector& res,int time );
+  ml::Matrix& computeGroupJcom( ComGroup* group,ml::Matrix& res,int time );
+  ///@}
+
 };
 
   std::ostream& operator<<(std::ostream& os, const CjrlHumanoidDynamicRobot& r);
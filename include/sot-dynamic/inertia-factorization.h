@@ -0,0 +1,280 @@
+/*
+ * Copyright 2010,
+ * François Bleibel,
+ * Olivier Stasse,
+ *
+ * CNRS/AIST
+ *
+ * This file is part of sot-dynamic.
+ * sot-dynamic is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ * sot-dynamic is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.  You should
+ * have received a copy of the GNU Lesser General Public License along
+ * with sot-dynamic.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SOT_INERTIA_FACTORIZATION_H__
+#define __SOT_INERTIA_FACTORIZATION_H__
+
+/* --------------------------------------------------------------------- */
+/* --- INCLUDE --------------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+/* STD */
+#include <vector>
+#include <ostream>
+
+/* Matrix */
+#include <jrl/mal/boost.hh>
+namespace ml = maal::boost;
+
+/* --------------------------------------------------------------------- */
+/* --- CLASS ----------------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+namespace dynamicgraph { namespace sot {
+
+/*! \brief Inertia matrix of a kinematic tree and its L'.D.L
+  factorization, stored by their structural nonzeros only.
+
+  M(i,j) can only be nonzero if the dofs i and j are on a same path to
+  the root. The dofs are numbered in a tree order, parents first, given
+  by order(): dof k of the tree order is dof order()[k] of the
+  configuration. parents()[k] is the parent of dof k in the tree order,
+  -1 for the first dof, and row k of the lower triangle of M only holds
+  the columns of its ancestors.
+
+  The factorization M = L'.D.L (L unit lower triangular, D diagonal)
+  keeps this structure: there is no fill-in. Its cost is proportional to
+  the sum of the squared depths of the dofs instead of n^3/3, and each
+  solve to the number of nonzeros instead of n^2 (see Featherstone,
+  "Efficient factorization of the joint-space inertia matrix for
+  branched kinematic trees", IJRR 2005).
+
+  All the vectors and matrices of the interface are in the order of the
+  configuration.
+*/
+class InertiaFactorization
+{
+ public:
+  InertiaFactorization( void ) : factorized_(false) {}
+
+  /*! \brief Set the structure. Nothing is reallocated when it is the
+    same as the current one. */
+  void setStructure( const std::vector<int>& parents,
+		     const std::vector<unsigned int>& order )
+  {
+    if( (parents==parents_)&&(order==order_) ) return;
+    parents_ = parents;
+    order_ = order;
+    const unsigned int n = parents.size();
+    start_.resize( n+1 );
+    start_[0] = 0;
+    for( unsigned int k=0;k<n;++k )
+      {
+	unsigned int depth = 0;
+	for( int j=parents[k];j>=0;j=parents[j] ) ++depth;
+	start_[k+1] = start_[k]+depth;
+      }
+    inertia_.resize( start_[n] );
+    diagonal_.resize( n );
+    factor_.resize( start_[n] );
+    D_.resize( n );
+    factorized_ = false;
+  }
+
+  unsigned int size( void ) const { return parents_.size(); }
+  const std::vector<int>& parents( void ) const { return parents_; }
+  const std::vector<unsigned int>& order( void ) const { return order_; }
+  /// Number of structural nonzeros of the lower triangle, diagonal
+  /// included.
+  unsigned int nonZeros( void ) const { return inertia_.size()+size(); }
+  bool factorized( void ) const { return factorized_; }
+
+  /*! \brief Read the structural nonzeros of the dense inertia matrix M
+    and factorize it.
+    \return false if M is not positive definite. */
+  bool factorize( const ml::Matrix& M )
+  {
+    const unsigned int n = size();
+    for( unsigned int k=0;k<n;++k )
+      {
+	diagonal_[k] = M( order_[k],order_[k] );
+	unsigned int e = start_[k];
+	for( int j=parents_[k];j>=0;j=parents_[j],++e )
+	  inertia_[e] = M( order_[k],order_[j] );
+      }
+    D_ = diagonal_;
+    factor_ = inertia_;
+
+    /* Row k holds the ancestors of k, nearest first. The ancestors of the
+     * m-th one, i, are the entries of row k after it, and those of row i. */
+    factorized_ = false;
+    for( unsigned int k=n;k-->0; )
+      {
+	if(! ( D_[k]>0. ) ) return false;
+	double* Lk = factor_.empty() ? 0 : &factor_[0]+start_[k];
+	const unsigned int depth = start_[k+1]-start_[k];
+	int i = parents_[k];
+	for( unsigned int m=0;m<depth;++m,i=parents_[i] )
+	  {
+	    const double a = Lk[m]/D_[k];
+	    D_[i] -= a*Lk[m];
+	    double* Li = &factor_[0]+start_[i];
+	    for( unsigned int p=0;m+1+p<depth;++p )
+	      Li[p] -= a*Lk[m+1+p];
+	    Lk[m] = a;
+	  }
+      }
+    factorized_ = true;
+    return true;
+  }
+
+  /*! \brief res = M.x, from the structural nonzeros. */
+  ml::Vector& multiply( const ml::Vector& x,ml::Vector& res ) const
+  {
+    const unsigned int n = size();
+    if( res.size()!=n ) res.resize( n );
+    for( unsigned int k=0;k<n;++k )
+      res(order_[k]) = diagonal_[k]*x(order_[k]);
+    for( unsigned int k=0;k<n;++k )
+      {
+	unsigned int e = start_[k];
+	for( int j=parents_[k];j>=0;j=parents_[j],++e )
+	  {
+	    res(order_[k]) += inertia_[e]*x(order_[j]);
+	    res(order_[j]) += inertia_[e]*x(order_[k]);
+	  }
+      }
+    return res;
+  }
+
+  /*! \brief res = M^-1.x */
+  ml::Vector& solve( const ml::Vector& x,ml::Vector& res ) const
+  {
+    const unsigned int n = size();
+    std::vector<double>& y = work_;
+    y.resize( n );
+    for( unsigned int k=0;k<n;++k ) y[k] = x(order_[k]);
+    solveInPlace( y );
+    if( res.size()!=n ) res.resize( n );
+    for( unsigned int k=0;k<n;++k ) res(order_[k]) = y[k];
+    return res;
+  }
+
+  /*! \brief res = M^-1.X, column by column. */
+  ml::Matrix& solve( const ml::Matrix& X,ml::Matrix& res ) const
+  {
+    const unsigned int n = size();
+    std::vector<double>& y = work_;
+    y.resize( n );
+    if( (res.nbRows()!=n)||(res.nbCols()!=X.nbCols()) )
+      res.resize( n,X.nbCols() );
+    for( unsigned int c=0;c<X.nbCols();++c )
+      {
+	for( unsigned int k=0;k<n;++k ) y[k] = X(order_[k],c);
+	solveInPlace( y );
+	for( unsigned int k=0;k<n;++k ) res(order_[k],c) = y[k];
+      }
+    return res;
+  }
+
+  /*! \brief Y = L^-T.J', for J of size() columns. Y is in the tree
+    order, like D: J.M^-1.J' = Y'.D^-1.Y, see projectedInverse. */
+  ml::Matrix& inverseLTransposeJt( const ml::Matrix& J,ml::Matrix& Y ) const
+  {
+    const unsigned int n = size();
+    std::vector<double>& y = work_;
+    y.resize( n );
+    if( (Y.nbRows()!=n)||(Y.nbCols()!=J.nbRows()) ) Y.resize( n,J.nbRows() );
+    for( unsigned int r=0;r<J.nbRows();++r )
+      {
+	for( unsigned int k=0;k<n;++k ) y[k] = J(r,order_[k]);
+	solveLTranspose( y );
+	for( unsigned int k=0;k<n;++k ) Y(k,r) = y[k];
+      }
+    return Y;
+  }
+
+  /*! \brief res = J.M^-1.J', for instance the inverse of the
+    operational-space inertia of the task of jacobian J. */
+  ml::Matrix& projectedInverse( const ml::Matrix& J,ml::Matrix& res ) const
+  {
+    ml::Matrix& Y = workMatrix_;
+    inverseLTransposeJt( J,Y );
+    const unsigned int m = J.nbRows();
+    if( (res.nbRows()!=m)||(res.nbCols()!=m) ) res.resize( m,m );
+    for( unsigned int r=0;r<m;++r )
+      for( unsigned int c=0;c<=r;++c )
+	{
+	  double sum = 0.;
+	  for( unsigned int k=0;k<size();++k ) sum += Y(k,r)*Y(k,c)/D_[k];
+	  res(r,c) = res(c,r) = sum;
+	}
+    return res;
+  }
+
+  /// \name Structural nonzeros, in the tree order. Row k of the lower
+  /// triangle (of M or L) holds the ancestors of dof k, nearest first,
+  /// from entry rowStart(k) to rowStart(k+1).
+  ///@{
+  unsigned int rowStart( const unsigned int k ) const { return start_[k]; }
+  const std::vector<double>& inertiaDiagonal( void ) const { return diagonal_; }
+  const std::vector<double>& inertiaLower( void ) const { return inertia_; }
+  const std::vector<double>& D( void ) const { return D_; }
+  const std::vector<double>& L( void ) const { return factor_; }
+  ///@}
+
+ private:
+  /* y = L^-T.y: L' is upper triangular, solved from the leaves. */
+  void solveLTranspose( std::vector<double>& y ) const
+  {
+    for( unsigned int k=size();k-->0; )
+      {
+	unsigned int e = start_[k];
+	for( int j=parents_[k];j>=0;j=parents_[j],++e )
+	  y[j] -= factor_[e]*y[k];
+      }
+  }
+
+  void solveInPlace( std::vector<double>& y ) const
+  {
+    solveLTranspose( y );
+    for( unsigned int k=0;k<size();++k ) y[k] /= D_[k];
+    for( unsigned int k=0;k<size();++k )
+      {
+	unsigned int e = start_[k];
+	for( int j=parents_[k];j>=0;j=parents_[j],++e )
+	  y[k] -= factor_[e]*y[j];
+      }
+  }
+
+  std::vector<int> parents_;
+  std::vector<unsigned int> order_;
+  std::vector<unsigned int> start_;
+  std::vector<double> diagonal_;
+  std::vector<double> inertia_;
+  std::vector<double> D_;
+  std::vector<double> factor_;
+  bool factorized_;
+  mutable std::vector<double> work_;
+  mutable ml::Matrix workMatrix_;
+};
+
+inline std::ostream& operator<<( std::ostream& os,const InertiaFactorization& F )
+{
+  os << "size: " << F.size() << ", nonzeros: " << F.nonZeros() << std::endl;
+  os << "D: [";
+  for( unsigned int k=0;k<F.D().size();++k ) os << " " << F.D()[k];
+  os << " ]";
+  return os;
+}
+
+} /* namespace sot */} /* namespace dynamicgraph */
+
+#endif // #ifndef __SOT_INERTIA_FACTORIZATION_H__
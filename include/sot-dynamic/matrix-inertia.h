@@ -25,16 +25,9 @@
 
 #include "jrl/mal/boost.hh"
 #include "jrl/mal/matrixabstractlayer.hh"
+namespace ml = maal::boost;
 
-#include <sot/core/matrix-twist.hh>
-#include <sot/core/matrix-force.hh>
-#include <sot/core/matrix-rotation.hh>
-#include <sot/core/matrix-homogeneous.hh>
-
-namespace dynamicsJRLJapan
-{
-  class HumanoidDynamicMultiBody;
-}
+#include <sot-dynamic/spatial-algebra.h>
 
 class CjrlHumanoidDynamicRobot;
 class CjrlJoint;
@@ -44,7 +37,7 @@ class CjrlJoint;
 /* --------------------------------------------------------------------- */
 
 #if defined (WIN32) 
-#  if defined (matrix_inertia_EXPORTS)
+#  if defined (matrix_inertia_EXPORTS) || defined (dynamic_EXPORTS)
 #    define SOTMATRIXINERTIA_EXPORT __declspec(dllexport)
 #  else  
 #    define SOTMATRIXINERTIA_EXPORT __declspec(dllimport)
@@ -60,15 +53,107 @@ namespace dg = dynamicgraph;
 /* -------------------------------------------------------------------------- */
 /* -------------------------------------------------------------------------- */
 /* -------------------------------------------------------------------------- */
+/*! \brief Joint-space inertia matrix computed by the composite rigid
+  body algorithm, in the frames of the joints.
+
+  The joints are read at init, through the abstract robot interface
+  only, and sorted parents first. Each one gets the transform kernel of
+  its type (fixed, revolute, prismatic, spherical or free flyer), chosen
+  by its number of dofs and, for one dof, by its jacobian. The static
+  parts of the transforms are read from the poses of the joints and the
+  motion subspaces from their jacobians: the forward kinematics of the
+  robot must have been computed before init. The velocity is thus
+  parameterized as in jrl-dynamics, whose free-flyer root has constant
+  axes in the world frame.
+*/
 class SOTMATRIXINERTIA_EXPORT MatrixInertia
 {
 public:
 
+  /*! \brief Storage of a symmetric matrix of size n in a buffer.
+    - DENSE: n*n entries, row-major, both halves.
+    - PACKED_UPPER: n(n+1)/2 entries, the upper triangle column by
+      column, as read by LAPACK dpptrf with UPLO='U'.
+    - LOWER_COLUMN_MAJOR: n*n entries, the lower triangle column-major,
+      as read by dpotrf with UPLO='L' and LDA=n. The strict upper
+      triangle is not written. */
+  enum Layout { DENSE=0, PACKED_UPPER, LOWER_COLUMN_MAJOR };
+
+  static size_t bufferSize( const size_t n,const Layout layout )
+  { return ( PACKED_UPPER==layout ) ? (n*(n+1))/2 : n*n; }
+
+  /// Position of (i,j) in the buffer. For the triangular layouts, (i,j)
+  /// and (j,i) share the same entry.
+  static size_t bufferIndex( const size_t i,const size_t j,const size_t n,
+			     const Layout layout )
+  {
+    const size_t lo = ( i<j ) ? i : j;
+    const size_t hi = ( i<j ) ? j : i;
+    switch( layout )
+      {
+      case PACKED_UPPER: return lo + (hi*(hi+1))/2;
+      case LOWER_COLUMN_MAJOR: return hi + lo*n;
+      default: return i*n + j;
+      }
+  }
+
+  /// Write the symmetric matrix A in buffer, of bufferSize entries.
+  static void pack( const ml::Matrix& A,const Layout layout,double* buffer )
+  {
+    const size_t n = A.nbRows();
+    for( size_t j=0;j<n;++j )
+      for( size_t i=( DENSE==layout ) ? 0 : j;i<n;++i )
+	buffer[ bufferIndex( i,j,n,layout ) ] = A(i,j);
+  }
+
  private:
-  MatrixInertia( void ) {}
+  MatrixInertia( void ) : bodyInertiasValid_( false ),dimension_( 0 ) {}
+
+  enum JointType
+  {
+    FIXED_JOINT=0,
+    REVOLUTE_JOINT,
+    PRISMATIC_JOINT,
+    SPHERICAL_JOINT,
+    FREEFLYER_JOINT
+  };
+
+  struct JointModel;
+  /* Transform from the parent frame to the joint frame at configuration q. */
+  typedef void (*TransformKernel)( const JointModel& joint,const vectorN& q,
+				   spatial::Transform& iXpi );
+
+  /* Constant description of a joint, read at init. */
+  struct JointModel
+  {
+    JointType type;
+    unsigned int rank;
+    unsigned int nbDof;
+    /* Index of the first column of the motion subspace in phi. */
+    unsigned int firstColumn;
+    /* Position of the joint frame in the parent frame at q=0. */
+    spatial::Vector3 translation;
+    /* Rotation from the parent frame to the joint frame at q=0. */
+    spatial::Matrix3 rotation;
+    /* Axis of a revolute or prismatic joint, in the joint frame. */
+    spatial::Vector3 axis;
+    /* The motion subspace is constant in the parent frame. */
+    bool parentAxes;
+    TransformKernel transform;
+  };
+
+  template< int TYPE >
+  static void jointTransform( const JointModel& joint,const vectorN& q,
+			      spatial::Transform& iXpi );
 
   void initParents( void );
+  void initJointModels( void );
   void initDofTable( void );
+  void initBodyInertias( void );
+  /* Accumulate the composite inertias and pass each entry of one
+   * triangle of the inertia matrix once to output(i,j,value), i and j in
+   * any order. The entries not passed are zero. */
+  template< class Output > void computeInertiaMatrix( Output& output );
 
  public:
   MatrixInertia( CjrlHumanoidDynamicRobot* aHDR );
@@ -78,22 +163,44 @@ public:
 public:
 
   void update( void );
+  /*! \brief To be called when the mass, the center of mass or the
+    inertia matrix of a body is edited (Dynamic::setMass,
+    setLocalCenterOfMass, setInertiaMatrix): the local inertias of the
+    bodies are only read from the model at init, or at the next
+    computeInertiaMatrix after this call. */
+  void invalidateBodyInertias( void ) { bodyInertiasValid_ = false; }
   void computeInertiaMatrix();
+  /*! \brief Compute the inertia matrix directly in A, of
+    bufferSize(getDimension(),layout) entries, without filling the dense
+    matrix returned by getInertiaMatrix(). */
+  void computeInertiaMatrix( double* A,const Layout layout );
   void getInertiaMatrix(double* A);
   const maal::boost::Matrix& getInertiaMatrix( void );
-  size_t getDoF() { return joints_.size(); }
+  size_t getDoF() const { return dimension_; }
+  /// Size of the inertia matrix.
+  size_t getDimension() const { return dimension_; }
 
 private:
 
   CjrlHumanoidDynamicRobot*                            aHDR_;
-  dynamicsJRLJapan::HumanoidDynamicMultiBody*          aHDMB_;
   std::vector<CjrlJoint*>                              joints_;
   std::vector<int>                                     parentIndex_;
  
-  std::vector< ml::Matrix >  Ic;
-  std::vector< ml::Vector >      phi;
-  std::vector< MatrixTwist >  iVpi;
-  std::vector< MatrixForce >  iVpiT;
+  /* Per-joint spatial quantities, in the joint frame, stored contiguously
+   * by joint index. */
+  /// Inertia of the body, constant between two model edits.
+  std::vector< spatial::Inertia > bodyInertia_;
+  bool bodyInertiasValid_;
+  /// Composite inertia of the subtree.
+  std::vector< spatial::Inertia > Ic;
+  std::vector< JointModel > jointModels_;
+  /// Motion subspaces of the joints, nbDof columns each.
+  std::vector< spatial::Motion > phi;
+  /// Columns of phi in the parent frame, for the joints with parentAxes.
+  std::vector< spatial::Motion > parentPhi;
+  /// Transform from the parent frame to the joint frame.
+  std::vector< spatial::Transform > iXpi;
+  size_t dimension_;
   ml::Matrix inertia_;
 
 
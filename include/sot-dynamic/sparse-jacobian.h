@@ -0,0 +1,138 @@
+/*
+ * Copyright 2010,
+ * François Bleibel,
+ * Olivier Stasse,
+ *
+ * CNRS/AIST
+ *
+ * This file is part of sot-dynamic.
+ * sot-dynamic is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ * sot-dynamic is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.  You should
+ * have received a copy of the GNU Lesser General Public License along
+ * with sot-dynamic.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SOT_SPARSE_JACOBIAN_H__
+#define __SOT_SPARSE_JACOBIAN_H__
+
+/* --------------------------------------------------------------------- */
+/* --- INCLUDE --------------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+/* STD */
+#include <vector>
+#include <ostream>
+
+/* Matrix */
+#include <jrl/mal/boost.hh>
+namespace ml = maal::boost;
+
+/* --------------------------------------------------------------------- */
+/* --- CLASS ----------------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+namespace dynamicgraph { namespace sot {
+
+/*! \brief Jacobian stored by its nonzero columns only.
+
+  The jacobian of a joint only depends on the degrees of freedom of the
+  joints from the root to this joint. The support is the sorted list of
+  these columns, and the compact matrix stores them contiguously: column
+  k of the compact matrix is column support()[k] of the dense jacobian.
+*/
+class SparseJacobian
+{
+ public:
+  SparseJacobian( void ) : nbCols_(0) {}
+
+  /*! \brief Set the shape of the dense jacobian and its support.
+    The compact storage is resized only if its dimension changes. */
+  void setSupport( const unsigned int nbRows,const unsigned int nbCols,
+		   const std::vector<unsigned int>& support )
+  {
+    nbCols_ = nbCols;
+    support_ = support;
+    if( (compact_.nbRows()!=nbRows)||(compact_.nbCols()!=support.size()) )
+      compact_.resize( nbRows,support.size() );
+  }
+
+  unsigned int nbRows( void ) const { return compact_.nbRows(); }
+  unsigned int nbCols( void ) const { return nbCols_; }
+  const std::vector<unsigned int>& support( void ) const { return support_; }
+  const ml::Matrix& compact( void ) const { return compact_; }
+  ml::Matrix& compact( void ) { return compact_; }
+
+  /*! \brief res = J.dq, with dq of size nbCols(). */
+  ml::Vector& multiply( const ml::Vector& dq,ml::Vector& res ) const
+  {
+    const unsigned int NBROWS = nbRows();
+    if( res.size()!=NBROWS ) res.resize(NBROWS);
+    for( unsigned int i=0;i<NBROWS;++i )
+      {
+	double sum = 0.;
+	for( unsigned int k=0;k<support_.size();++k )
+	  sum += compact_(i,k)*dq(support_[k]);
+	res(i) = sum;
+      }
+    return res;
+  }
+
+  /*! \brief res = J'.f, with res of size nbCols(). The entries outside
+    the support are set to zero. */
+  ml::Vector& transposeMultiply( const ml::Vector& f,ml::Vector& res ) const
+  {
+    if( res.size()!=nbCols_ ) res.resize(nbCols_);
+    else res.fill(0.);
+    for( unsigned int k=0;k<support_.size();++k )
+      {
+	double sum = 0.;
+	for( unsigned int i=0;i<nbRows();++i )
+	  sum += compact_(i,k)*f(i);
+	res(support_[k]) = sum;
+      }
+    return res;
+  }
+
+  /*! \brief Write the jacobian in rows [row,row+nbRows()) of a dense
+    matrix of nbCols() columns, for instance to stack several tasks.
+    Only the columns of the support are written: the other columns of
+    these rows are expected to be zero. */
+  ml::Matrix& stackInto( ml::Matrix& stack,const unsigned int row ) const
+  {
+    for( unsigned int i=0;i<nbRows();++i )
+      for( unsigned int k=0;k<support_.size();++k )
+	stack(row+i,support_[k]) = compact_(i,k);
+    return stack;
+  }
+
+  /*! \brief Expand to the dense jacobian. */
+  ml::Matrix& toDense( ml::Matrix& res ) const
+  {
+    res.resize( nbRows(),nbCols_ );
+    return stackInto( res,0 );
+  }
+
+ private:
+  unsigned int nbCols_;
+  std::vector<unsigned int> support_;
+  ml::Matrix compact_;
+};
+
+inline std::ostream& operator<<( std::ostream& os,const SparseJacobian& J )
+{
+  os << "support: [";
+  for( unsigned int k=0;k<J.support().size();++k )
+    os << " " << J.support()[k];
+  os << " ]" << std::endl << J.compact();
+  return os;
+}
+
+} /* namespace sot */} /* namespace dynamicgraph */
+
+#endif // #ifndef __SOT_SPARSE_JACOBIAN_H__
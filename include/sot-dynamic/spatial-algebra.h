@@ -0,0 +1,340 @@
+/*
+ * Copyright 2010,
+ * François Bleibel,
+ * Olivier Stasse,
+ *
+ * CNRS/AIST
+ *
+ * This file is part of sot-dynamic.
+ * sot-dynamic is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ * sot-dynamic is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.  You should
+ * have received a copy of the GNU Lesser General Public License along
+ * with sot-dynamic.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SOT_SPATIAL_ALGEBRA_H__
+#define __SOT_SPATIAL_ALGEBRA_H__
+
+/* --------------------------------------------------------------------- */
+/* --- INCLUDE --------------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+/* --------------------------------------------------------------------- */
+/* --- CLASS ----------------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+namespace dynamicgraph { namespace sot { namespace spatial {
+
+/*! \brief Fixed-size 3D and spatial (6D) algebra on the stack.
+
+  Spatial vectors follow the Plucker convention of Featherstone:
+  a motion is (angular velocity, linear velocity of the point at the
+  origin of the frame), a force is (moment at the origin, force).
+*/
+
+struct Vector3
+{
+  double x,y,z;
+
+  Vector3( void ) : x(0.),y(0.),z(0.) {}
+  Vector3( const double a,const double b,const double c ) : x(a),y(b),z(c) {}
+
+  double operator[]( const unsigned int i ) const { return (0==i) ? x : ( (1==i) ? y : z ); }
+  double& operator[]( const unsigned int i ) { return (0==i) ? x : ( (1==i) ? y : z ); }
+
+  Vector3& operator+=( const Vector3& v ) { x+=v.x; y+=v.y; z+=v.z; return *this; }
+  Vector3& operator-=( const Vector3& v ) { x-=v.x; y-=v.y; z-=v.z; return *this; }
+  Vector3& operator*=( const double s ) { x*=s; y*=s; z*=s; return *this; }
+};
+
+inline Vector3 operator+( const Vector3& a,const Vector3& b )
+{ return Vector3( a.x+b.x,a.y+b.y,a.z+b.z ); }
+inline Vector3 operator-( const Vector3& a,const Vector3& b )
+{ return Vector3( a.x-b.x,a.y-b.y,a.z-b.z ); }
+inline Vector3 operator-( const Vector3& a )
+{ return Vector3( -a.x,-a.y,-a.z ); }
+inline Vector3 operator*( const double s,const Vector3& a )
+{ return Vector3( s*a.x,s*a.y,s*a.z ); }
+inline double dot( const Vector3& a,const Vector3& b )
+{ return a.x*b.x + a.y*b.y + a.z*b.z; }
+inline Vector3 cross( const Vector3& a,const Vector3& b )
+{ return Vector3( a.y*b.z-a.z*b.y,a.z*b.x-a.x*b.z,a.x*b.y-a.y*b.x ); }
+
+/*! \brief 3x3 matrix, stored row-major. */
+struct Matrix3
+{
+  double m[9];
+
+  Matrix3( void ) { for( unsigned int i=0;i<9;++i ) m[i]=0.; }
+
+  static Matrix3 identity( void )
+  { Matrix3 r; r.m[0]=r.m[4]=r.m[8]=1.; return r; }
+
+  double operator()( const unsigned int i,const unsigned int j ) const { return m[3*i+j]; }
+  double& operator()( const unsigned int i,const unsigned int j ) { return m[3*i+j]; }
+
+  Matrix3& operator+=( const Matrix3& a )
+  { for( unsigned int i=0;i<9;++i ) m[i]+=a.m[i]; return *this; }
+
+  Matrix3 transpose( void ) const
+  {
+    Matrix3 r;
+    for( unsigned int i=0;i<3;++i )
+      for( unsigned int j=0;j<3;++j )
+	r.m[3*i+j] = m[3*j+i];
+    return r;
+  }
+};
+
+inline Vector3 operator*( const Matrix3& a,const Vector3& v )
+{
+  return Vector3( a.m[0]*v.x + a.m[1]*v.y + a.m[2]*v.z,
+		  a.m[3]*v.x + a.m[4]*v.y + a.m[5]*v.z,
+		  a.m[6]*v.x + a.m[7]*v.y + a.m[8]*v.z );
+}
+/*! \brief a'.v */
+inline Vector3 transposeMultiply( const Matrix3& a,const Vector3& v )
+{
+  return Vector3( a.m[0]*v.x + a.m[3]*v.y + a.m[6]*v.z,
+		  a.m[1]*v.x + a.m[4]*v.y + a.m[7]*v.z,
+		  a.m[2]*v.x + a.m[5]*v.y + a.m[8]*v.z );
+}
+inline Matrix3 operator*( const Matrix3& a,const Matrix3& b )
+{
+  Matrix3 r;
+  for( unsigned int i=0;i<3;++i )
+    for( unsigned int j=0;j<3;++j )
+      r.m[3*i+j] = a.m[3*i]*b.m[j] + a.m[3*i+1]*b.m[3+j] + a.m[3*i+2]*b.m[6+j];
+  return r;
+}
+inline Matrix3 operator+( const Matrix3& a,const Matrix3& b )
+{ Matrix3 r(a); r+=b; return r; }
+inline Matrix3 operator-( const Matrix3& a,const Matrix3& b )
+{ Matrix3 r; for( unsigned int i=0;i<9;++i ) r.m[i]=a.m[i]-b.m[i]; return r; }
+/*! \brief [v] such that [v].w = v x w. */
+inline Matrix3 skew( const Vector3& v )
+{
+  Matrix3 r;
+  r.m[1]=-v.z; r.m[2]= v.y;
+  r.m[3]= v.z; r.m[5]=-v.x;
+  r.m[6]=-v.y; r.m[7]= v.x;
+  return r;
+}
+
+/*! \brief Spatial motion vector (twist, spatial velocity or acceleration). */
+struct Motion
+{
+  Vector3 angular;
+  Vector3 linear;
+
+  Motion( void ) {}
+  Motion( const Vector3& w,const Vector3& v ) : angular(w),linear(v) {}
+
+  Motion& operator+=( const Motion& a )
+  { angular+=a.angular; linear+=a.linear; return *this; }
+  Motion& operator-=( const Motion& a )
+  { angular-=a.angular; linear-=a.linear; return *this; }
+
+  /*! \brief Linear velocity of the point p. */
+  Vector3 pointVelocity( const Vector3& p ) const
+  { return linear + cross( angular,p ); }
+};
+
+inline Motion operator+( const Motion& a,const Motion& b )
+{ return Motion( a.angular+b.angular,a.linear+b.linear ); }
+inline Motion operator-( const Motion& a,const Motion& b )
+{ return Motion( a.angular-b.angular,a.linear-b.linear ); }
+inline Motion operator*( const double s,const Motion& a )
+{ return Motion( s*a.angular,s*a.linear ); }
+
+/*! \brief Spatial force vector (wrench, momentum). */
+struct Force
+{
+  Vector3 angular;
+  Vector3 linear;
+
+  Force( void ) {}
+  Force( const Vector3& n,const Vector3& f ) : angular(n),linear(f) {}
+
+  Force& operator+=( const Force& a )
+  { angular+=a.angular; linear+=a.linear; return *this; }
+  Force& operator-=( const Force& a )
+  { angular-=a.angular; linear-=a.linear; return *this; }
+
+  /*! \brief Moment at the point p. */
+  Vector3 momentAt( const Vector3& p ) const
+  { return angular - cross( p,linear ); }
+};
+
+inline Force operator+( const Force& a,const Force& b )
+{ return Force( a.angular+b.angular,a.linear+b.linear ); }
+inline Force operator-( const Force& a,const Force& b )
+{ return Force( a.angular-b.angular,a.linear-b.linear ); }
+inline Force operator*( const double s,const Force& a )
+{ return Force( s*a.angular,s*a.linear ); }
+
+/*! \brief Power of f along m. */
+inline double dot( const Motion& m,const Force& f )
+{ return dot( m.angular,f.angular ) + dot( m.linear,f.linear ); }
+
+/*! \brief Motion cross product a x b (derivative of b moving with a). */
+inline Motion cross( const Motion& a,const Motion& b )
+{
+  return Motion( cross( a.angular,b.angular ),
+		 cross( a.angular,b.linear ) + cross( a.linear,b.angular ) );
+}
+/*! \brief Force cross product a x* f. */
+inline Force cross( const Motion& a,const Force& f )
+{
+  return Force( cross( a.angular,f.angular ) + cross( a.linear,f.linear ),
+		cross( a.angular,f.linear ) );
+}
+
+/*! \brief Spatial inertia at the origin of the frame.
+
+  Stored as the mass, the first moment h = m.c and the rotational
+  inertia about the origin. Sums of rigid-body inertias are closed
+  under this representation. */
+struct Inertia
+{
+  double mass;
+  Vector3 h;
+  Matrix3 I;
+
+  Inertia( void ) : mass(0.) {}
+
+  /*! \brief Inertia of a body of mass m, center of mass c and rotational
+    inertia Ic about c, all expressed in the frame. */
+  static Inertia fromBody( const double m,const Vector3& c,const Matrix3& Ic )
+  {
+    Inertia r;
+    r.mass = m;
+    r.h = m*c;
+    /* Parallel axis theorem: I = Ic + m.[c].[c]' */
+    const Matrix3 C = skew(c);
+    r.I = Ic;
+    const Matrix3 CCt = C*C.transpose();
+    for( unsigned int i=0;i<9;++i ) r.I.m[i] += m*CCt.m[i];
+    return r;
+  }
+
+  Inertia& operator+=( const Inertia& a )
+  { mass+=a.mass; h+=a.h; I+=a.I; return *this; }
+
+  /*! \brief Center of mass, the origin if the mass is zero. */
+  Vector3 centerOfMass( void ) const
+  { return ( mass>0. ) ? (1./mass)*h : Vector3(); }
+};
+
+/*! \brief Momentum I.v of a body of inertia I moving at v. */
+inline Force operator*( const Inertia& I,const Motion& v )
+{
+  return Force( I.I*v.angular + cross( I.h,v.linear ),
+		I.mass*v.linear - cross( I.h,v.angular ) );
+}
+
+/*! \brief General symmetric spatial inertia, such as the articulated
+  inertia of a subtree, which is not the inertia of a rigid body.
+
+  The force is I.v = ( A.w + B.v, B'.w + C.v ) for the motion v=(w,v),
+  with A and C symmetric. */
+struct ArticulatedInertia
+{
+  Matrix3 A;
+  Matrix3 B;
+  Matrix3 C;
+
+  ArticulatedInertia( void ) {}
+  ArticulatedInertia( const Inertia& I )
+    : A(I.I),B(skew(I.h)),C()
+  { C.m[0]=C.m[4]=C.m[8]=I.mass; }
+
+  ArticulatedInertia& operator+=( const ArticulatedInertia& a )
+  { A+=a.A; B+=a.B; C+=a.C; return *this; }
+
+  /*! \brief Add s.a.b', for two forces a and b. Adding the symmetric
+    combinations only keeps the result symmetric. */
+  void addOuter( const double s,const Force& a,const Force& b )
+  {
+    for( unsigned int i=0;i<3;++i )
+      for( unsigned int j=0;j<3;++j )
+	{
+	  A(i,j) += s*a.angular[i]*b.angular[j];
+	  B(i,j) += s*a.angular[i]*b.linear[j];
+	  C(i,j) += s*a.linear[i]*b.linear[j];
+	}
+  }
+};
+
+inline Force operator*( const ArticulatedInertia& I,const Motion& v )
+{
+  return Force( I.A*v.angular + I.B*v.linear,
+		transposeMultiply( I.B,v.angular ) + I.C*v.linear );
+}
+
+/*! \brief Plucker transform from a frame A to a frame B, stored as the
+  rotation E (v_B = E.v_A for a 3D vector) and the position r of the
+  origin of B in A: as a 6x6 matrix on motions, [ E 0 ; -E.[r] E ].
+  Only the products that the recursive algorithms need are provided, each
+  in tens of operations instead of the hundreds of the dense product. */
+struct Transform
+{
+  Matrix3 E;
+  Vector3 r;
+
+  Transform( void ) : E(Matrix3::identity()) {}
+  Transform( const Matrix3& rotation,const Vector3& position )
+    : E(rotation),r(position) {}
+
+  /*! \brief The motion v of A expressed in B. */
+  Motion apply( const Motion& v ) const
+  { return Motion( E*v.angular,E*( v.linear - cross( r,v.angular ) ) ); }
+
+  /*! \brief X'.f: the force f of B expressed in A. */
+  Force applyTranspose( const Force& f ) const
+  {
+    const Vector3 linear = transposeMultiply( E,f.linear );
+    return Force( transposeMultiply( E,f.angular ) + cross( r,linear ),linear );
+  }
+
+  /*! \brief X'.I.X: the inertia I of B expressed in A. */
+  Inertia applyTranspose( const Inertia& I ) const
+  {
+    Inertia res;
+    res.mass = I.mass;
+    const Vector3 h = transposeMultiply( E,I.h );
+    res.h = h + I.mass*r;
+    /* E'.I.E, symmetric. */
+    const Matrix3 IE = I.I*E;
+    for( unsigned int i=0;i<3;++i )
+      for( unsigned int j=i;j<3;++j )
+	res.I(i,j) = res.I(j,i)
+	  = E(0,i)*IE(0,j) + E(1,i)*IE(1,j) + E(2,i)*IE(2,j);
+    /* Shift of the origin from B to A, with h the first moment about B
+     * in the axes of A:
+     * - m.[r]^2 - [r].[h] - [h].[r]
+     * = m.( |r|^2.Id - r.r' ) + 2.(r.h).Id - r.h' - h.r' */
+    const double d = I.mass*dot( r,r ) + 2.*dot( r,h );
+    for( unsigned int i=0;i<3;++i )
+      {
+	res.I(i,i) += d;
+	for( unsigned int j=i;j<3;++j )
+	  {
+	    const double s = I.mass*r[i]*r[j] + r[i]*h[j] + h[i]*r[j];
+	    res.I(i,j) -= s;
+	    if( i!=j ) res.I(j,i) -= s;
+	  }
+      }
+    return res;
+  }
+};
+
+} /* namespace spatial */} /* namespace sot */} /* namespace dynamicgraph */
+
+#endif // #ifndef __SOT_SPATIAL_ALGEBRA_H__
@@ -449,10 +449,51 @@ namespace dynamicgraph { namespace sot {
       {
 	Dynamic& robot = static_cast<Dynamic&>(owner());
 	robot.m_HDR->initialize();
+	robot.invalidateJointRegistry();
 	return Value();
       }
     }; // class InitializeRobot
 
+    // Command GetJointTable
+    class GetJointTable : public Command
+    {
+    public:
+      virtual ~GetJointTable() {}
+      /// Create command and store it in Entity
+      /// \param entity instance of Entity owning this command
+      /// \param docstring documentation of the command
+      GetJointTable(Dynamic& entity, const std::string& docstring) :
+	Command(entity, std::vector<Value::Type>(),
+		docstring)
+      {
+      }
+      virtual Value doExecute()
+      {
+	Dynamic& robot = static_cast<Dynamic&>(owner());
+	return Value(robot.getJointTable());
+      }
+    }; // class GetJointTable
+
+    // Command GetJointNames
+    class GetJointNames : public Command
+    {
+    public:
+      virtual ~GetJointNames() {}
+      /// Create command and store it in Entity
+      /// \param entity instance of Entity owning this command
+      /// \param docstring documentation of the command
+      GetJointNames(Dynamic& entity, const std::string& docstring) :
+	Command(entity, std::vector<Value::Type>(),
+		docstring)
+      {
+      }
+      virtual Value doExecute()
+      {
+	Dynamic& robot = static_cast<Dynamic&>(owner());
+	return Value(robot.getJointNames());
+      }
+    }; // class GetJointNames
+
     // Command GetDimension
     class GetDimension : public Command
     {
@@ -21,6 +21,11 @@
 #include <sot/core/debug.hh>
 #include <sot-dynamic/dynamic.h>
 
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstdlib>
+
 #include <boost/version.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
@@ -33,6 +38,9 @@
 #include <dynamic-graph/all-commands.h>
 
 #include "../src/dynamic-command.h"
+#include "rigid-body-tree.h"
+#include "signal-worker-pool.h"
+#include "model-cache.h"
 
 
 using namespace dynamicgraph::sot;
@@ -73,6 +81,23 @@ static matrix3d maalToMatrix3d(const ml::Matrix& inMatrix)
   return matrix;
 }
 
+static vector3d arrayToVector3d(const double* inArray)
+{
+  return vector3d(inArray[0], inArray[1], inArray[2]);
+}
+
+/* Properties of m_HDR switched off by the reduced stages, and the order
+ * from which each of them is required. */
+static const char* STAGE_PROPERTY_NAMES[] =
+  { "ComputeVelocity", "ComputeMomentum",
+    "ComputeAcceleration", "ComputeAccelerationCoM",
+    "ComputeZMP", "ComputeBackwardDynamics" };
+static const Dynamic::KinematicsOrder STAGE_PROPERTY_ORDERS[] =
+  { Dynamic::VELOCITY_ORDER, Dynamic::VELOCITY_ORDER,
+    Dynamic::ACCELERATION_ORDER, Dynamic::ACCELERATION_ORDER,
+    Dynamic::ACCELERATION_ORDER, Dynamic::ACCELERATION_ORDER };
+static const unsigned int NB_STAGE_PROPERTIES = 6;
+
 Dynamic::
 Dynamic( const std::string & name, bool build )
   :Entity(name)
@@ -91,53 +116,75 @@ Dynamic( const std::string & name, bool build )
   ,freeFlyerVelocitySIN(NULL,"sotDynamic("+name+")::input(vector)::ffvelocity")
   ,jointAccelerationSIN(NULL,"sotDynamic("+name+")::input(vector)::acceleration")
   ,freeFlyerAccelerationSIN(NULL,"sotDynamic("+name+")::input(vector)::ffacceleration")
+  ,jointTorqueSIN(NULL,"sotDynamic("+name+")::input(vector)::torque")
 
   ,firstSINTERN( boost::bind(&Dynamic::initNewtonEuler,this,_1,_2),
 		 sotNOSIGNAL,"sotDynamic("+name+")::intern(dummy)::init" )
+  ,kinematicsSINTERN( boost::bind(&Dynamic::computeKinematics,this,_1,_2),
+		      firstSINTERN<<jointPositionSIN<<freeFlyerPositionSIN,
+		      "sotDynamic("+name+")::intern(dummy)::kinematics" )
+  ,velocityKinematicsSINTERN( boost::bind(&Dynamic::computeVelocityKinematics,
+					  this,_1,_2),
+			      firstSINTERN<<jointPositionSIN<<freeFlyerPositionSIN
+			      <<jointVelocitySIN<<freeFlyerVelocitySIN,
+			      "sotDynamic("+name+")::intern(dummy)::velocitykinematics" )
   ,newtonEulerSINTERN( boost::bind(&Dynamic::computeNewtonEuler,this,_1,_2),
 		       firstSINTERN<<jointPositionSIN<<freeFlyerPositionSIN
 		       <<jointVelocitySIN<<freeFlyerVelocitySIN
 		       <<jointAccelerationSIN<<freeFlyerAccelerationSIN,
 		       "sotDynamic("+name+")::intern(dummy)::newtoneuleur" )
+  ,comSINTERN( boost::bind(&Dynamic::computeComPass,this,_1,_2),
+	       kinematicsSINTERN,
+	       "sotDynamic("+name+")::intern(dummy)::com" )
+  ,treeVelocitySINTERN( boost::bind(&Dynamic::computeTreeVelocity,this,_1,_2),
+			velocityKinematicsSINTERN,
+			"sotDynamic("+name+")::intern(dummy)::treevelocity" )
 
   ,zmpSOUT( boost::bind(&Dynamic::computeZmp,this,_1,_2),
 	    newtonEulerSINTERN,
 	    "sotDynamic("+name+")::output(vector)::zmp" )
   ,JcomSOUT( boost::bind(&Dynamic::computeJcom,this,_1,_2),
-	     newtonEulerSINTERN,
+	     comSINTERN,
 	     "sotDynamic("+name+")::output(matrix)::Jcom" )
   ,comSOUT( boost::bind(&Dynamic::computeCom,this,_1,_2),
-	    newtonEulerSINTERN,
+	    comSINTERN,
 	    "sotDynamic("+name+")::output(vector)::com" )
   ,inertiaSOUT( boost::bind(&Dynamic::computeInertia,this,_1,_2),
-		newtonEulerSINTERN,
+		kinematicsSINTERN,
 		"sotDynamic("+name+")::output(matrix)::inertia" )
+  ,inertiaPackedSOUT( boost::bind(&Dynamic::computeInertiaPacked,this,_1,_2),
+		      kinematicsSINTERN,
+		      "sotDynamic("+name+")::output(matrix)::inertiaPacked" )
   ,footHeightSOUT( boost::bind(&Dynamic::computeFootHeight,this,_1,_2),
-		   newtonEulerSINTERN,
+		   kinematicsSINTERN,
 		   "sotDynamic("+name+")::output(double)::footHeight" )
 
+  ,limitsSOUT( boost::bind(&Dynamic::computeLimits,this,_1,_2),
+	       sotNOSIGNAL,
+	       "sotDynamic("+name+")::output(matrix)::limits" )
+
   ,upperJlSOUT( boost::bind(&Dynamic::getUpperJointLimits,this,_1,_2),
-		sotNOSIGNAL,
+		limitsSOUT,
 		"sotDynamic("+name+")::output(vector)::upperJl" )
 
   ,lowerJlSOUT( boost::bind(&Dynamic::getLowerJointLimits,this,_1,_2),
-		sotNOSIGNAL,
+		limitsSOUT,
 		"sotDynamic("+name+")::output(vector)::lowerJl" )
 
   ,upperVlSOUT( boost::bind(&Dynamic::getUpperVelocityLimits,this,_1,_2),
-    sotNOSIGNAL,
+    limitsSOUT,
     "sotDynamic("+name+")::output(vector)::upperVl" )
 
   ,lowerVlSOUT( boost::bind(&Dynamic::getLowerVelocityLimits,this,_1,_2),
-    sotNOSIGNAL,
+    limitsSOUT,
     "sotDynamic("+name+")::output(vector)::lowerVl" )
 
   ,upperTlSOUT( boost::bind(&Dynamic::getUpperTorqueLimits,this,_1,_2),
-    sotNOSIGNAL,
+    limitsSOUT,
     "sotDynamic("+name+")::output(vector)::upperTl" )
 
   ,lowerTlSOUT( boost::bind(&Dynamic::getLowerTorqueLimits,this,_1,_2),
-    sotNOSIGNAL,
+    limitsSOUT,
     "sotDynamic("+name+")::output(vector)::lowerTl" )
 
   ,inertiaRotorSOUT( "sotDynamic("+name+")::output(matrix)::inertiaRotor" )
@@ -146,20 +193,93 @@ Dynamic( const std::string & name, bool build )
 		    inertiaSOUT << gearRatioSOUT << inertiaRotorSOUT,
 		    "sotDynamic("+name+")::output(matrix)::inertiaReal" )
   ,MomentaSOUT( boost::bind(&Dynamic::computeMomenta,this,_1,_2),
-		newtonEulerSINTERN,
+		velocityKinematicsSINTERN,
 		"sotDynamic("+name+")::output(vector)::momenta" )
   ,AngularMomentumSOUT( boost::bind(&Dynamic::computeAngularMomentum,this,_1,_2),
-			newtonEulerSINTERN,
+			velocityKinematicsSINTERN,
 			"sotDynamic("+name+")::output(vector)::angularmomentum" )
   ,dynamicDriftSOUT( boost::bind(&Dynamic::computeTorqueDrift,this,_1,_2),
 		     newtonEulerSINTERN,
 		     "sotDynamic("+name+")::output(vector)::dynamicDrift" )
+  ,AgSOUT( boost::bind(&Dynamic::computeAg,this,_1,_2),
+	   comSINTERN,
+	   "sotDynamic("+name+")::output(matrix)::Ag" )
+  ,dAgvSOUT( boost::bind(&Dynamic::computeAgDrift,this,_1,_2),
+	     comSINTERN<<treeVelocitySINTERN,
+	     "sotDynamic("+name+")::output(vector)::dAgv" )
+  ,gravityTorqueSOUT( boost::bind(&Dynamic::computeGravityTorque,this,_1,_2),
+		      kinematicsSINTERN,
+		      "sotDynamic("+name+")::output(vector)::gravityTorque" )
+  ,nonlinearEffectsSOUT( boost::bind(&Dynamic::computeNonlinearEffects,this,_1,_2),
+			 treeVelocitySINTERN,
+			 "sotDynamic("+name+")::output(vector)::nonlinearEffects" )
+  ,forwardDynamicsSOUT( boost::bind(&Dynamic::computeForwardDynamics,this,_1,_2),
+			treeVelocitySINTERN<<jointTorqueSIN,
+			"sotDynamic("+name+")::output(vector)::forwardDynamics" )
+  ,inertiaFactorizationSOUT( boost::bind(&Dynamic::computeInertiaFactorization,
+					 this,_1,_2),
+			     kinematicsSINTERN,
+			     "sotDynamic("+name+")::output(factorization)::inertiaFactorization" )
+  ,dJcomvSOUT( boost::bind(&Dynamic::computeJcomDrift,this,_1,_2),
+	       treeVelocitySINTERN,
+	       "sotDynamic("+name+")::output(vector)::dJcomv" )
+  ,inertiaReducedSOUT( boost::bind(&Dynamic::computeInertiaReduced,this,_1,_2),
+		       inertiaSOUT,
+		       "sotDynamic("+name+")::output(matrix)::inertiaReduced" )
+  ,JcomReducedSOUT( boost::bind(&Dynamic::computeJcomReduced,this,_1,_2),
+		    JcomSOUT,
+		    "sotDynamic("+name+")::output(matrix)::JcomReduced" )
+  ,dynamicDriftReducedSOUT( boost::bind(&Dynamic::computeTorqueDriftReduced,this,_1,_2),
+			    dynamicDriftSOUT,
+			    "sotDynamic("+name+")::output(vector)::dynamicDriftReduced" )
+  ,crba_( NULL )
 {
   sotDEBUGIN(5);
 
   if( build ) buildModel();
 
   firstSINTERN.setDependencyType(TimeDependency<int>::BOOL_DEPENDENT);
+  limitsSOUT.setDependencyType(TimeDependency<int>::BOOL_DEPENDENT);
+  upperJlSOUT.setDependencyType(TimeDependency<int>::BOOL_DEPENDENT);
+  lowerJlSOUT.setDependencyType(TimeDependency<int>::BOOL_DEPENDENT);
+  upperVlSOUT.setDependencyType(TimeDependency<int>::BOOL_DEPENDENT);
+  lowerVlSOUT.setDependencyType(TimeDependency<int>::BOOL_DEPENDENT);
+  upperTlSOUT.setDependencyType(TimeDependency<int>::BOOL_DEPENDENT);
+  lowerTlSOUT.setDependencyType(TimeDependency<int>::BOOL_DEPENDENT);
+  invalidateLimits();
+  stageTime_ = std::numeric_limits<int>::min();
+  stageOrder_ = POSITION_ORDER;
+  stageCount_ = 0;
+  stagePropertyOff_ = "false";
+  stagePropertyNames_.assign( STAGE_PROPERTY_NAMES,
+			      STAGE_PROPERTY_NAMES+NB_STAGE_PROPERTIES );
+  stagePropertyValues_.resize( NB_STAGE_PROPERTIES );
+  stagePropertySaved_.resize( NB_STAGE_PROPERTIES,false );
+  parallelTasksReady_ = false;
+  workerPool_ = 0;
+  prefetchStage_ = 0;
+  opPointDrift_ = false;
+  jointRegistryReady_ = false;
+  tree_ = new RigidBodyTree;
+  treePositionStage_ = 0;
+  /* The cache is on by default, an empty SOT_DYNAMIC_MODEL_CACHE
+   * disables it. */
+  if( 0!=getenv("SOT_DYNAMIC_MODEL_CACHE") )
+    modelCacheDirectory_ = getenv("SOT_DYNAMIC_MODEL_CACHE");
+  else if( 0!=getenv("XDG_CACHE_HOME") )
+    modelCacheDirectory_ = std::string( getenv("XDG_CACHE_HOME") ) + "/sot-dynamic";
+  else if( 0!=getenv("HOME") )
+    modelCacheDirectory_ = std::string( getenv("HOME") ) + "/.cache/sot-dynamic";
+  comGroups_.push_back( ComGroup() );
+  inertiaMemoValid_ = false;
+  inertiaMemoVersion_ = 0;
+  inertiaRealVersion_ = std::numeric_limits<unsigned int>::max();
+  inertiaTolerance_ = 0.;
+  inertiaLayout_ = MatrixInertia::DENSE;
+  inertiaMemoHits_ = 0;
+  inertiaMemoMisses_ = 0;
+  crbaReady_ = false;
+  debugInertia = 0;
   //DEBUG: Why =0? should be function. firstSINTERN.setConstant(0);
 
   signalRegistration(jointPositionSIN);
@@ -172,6 +292,7 @@ Dynamic( const std::string & name, bool build )
   signalRegistration(comSOUT);
   signalRegistration(JcomSOUT);
   signalRegistration(footHeightSOUT);
+  signalRegistration(limitsSOUT);
   signalRegistration(upperJlSOUT);
   signalRegistration(lowerJlSOUT);
   signalRegistration(upperVlSOUT);
@@ -179,12 +300,24 @@ Dynamic( const std::string & name, bool build )
   signalRegistration(upperTlSOUT);
   signalRegistration(lowerTlSOUT);
   signalRegistration(inertiaSOUT);
+  signalRegistration(inertiaPackedSOUT);
   signalRegistration(inertiaRealSOUT);
   signalRegistration(inertiaRotorSOUT);
   signalRegistration(gearRatioSOUT);
   signalRegistration( MomentaSOUT);
   signalRegistration(AngularMomentumSOUT);
+  signalRegistration(AgSOUT);
+  signalRegistration(dAgvSOUT);
+  signalRegistration(gravityTorqueSOUT);
+  signalRegistration(nonlinearEffectsSOUT);
+  signalRegistration(jointTorqueSIN);
+  signalRegistration(forwardDynamicsSOUT);
+  signalRegistration(inertiaFactorizationSOUT);
+  signalRegistration(dJcomvSOUT);
   signalRegistration(dynamicDriftSOUT);
+  signalRegistration(inertiaReducedSOUT);
+  signalRegistration(JcomReducedSOUT);
+  signalRegistration(dynamicDriftReducedSOUT);
 
   //
   // Commands
@@ -211,10 +344,36 @@ Dynamic( const std::string & name, bool build )
     "\n"
     "      No input.\n"
     "      Files are defined by command setFiles \n"
+    "      The result is cached in the directory of\n"
+    "      getModelCacheDirectory, created on the first parse, and read\n"
+    "      from there when the files have not changed.\n"
     "\n";
     addCommand("parse",
 	       new command::Parse(*this, docstring));
 
+    docstring = "    \n"
+      "    Set the directory of the cache of the parsed models.\n"
+      "    \n"
+      "      Input\n"
+      "        - a string: the directory, created if needed, or an empty\n"
+      "          string to disable the cache.\n"
+      "    \n"
+      "      The default is the environment variable\n"
+      "      SOT_DYNAMIC_MODEL_CACHE if set (empty to disable the cache),\n"
+      "      $XDG_CACHE_HOME/sot-dynamic or $HOME/.cache/sot-dynamic\n"
+      "      otherwise.\n"
+      "    \n";
+    addCommand("setModelCacheDirectory",
+	       new dynamicgraph::command::Setter<Dynamic, std::string>
+	       (*this, &Dynamic::setModelCacheDirectory, docstring));
+
+    docstring = "    \n"
+      "    Get the directory of the cache of the parsed models.\n"
+      "    \n";
+    addCommand("getModelCacheDirectory",
+	       new dynamicgraph::command::Getter<Dynamic, std::string>
+	       (*this, &Dynamic::getModelCacheDirectory, docstring));
+
     {
       using namespace ::dynamicgraph::command;
       // CreateOpPoint
@@ -230,6 +389,21 @@ Dynamic( const std::string & name, bool build )
 		 makeCommandVoid2(*this,&Dynamic::cmd_createOpPointSignals,
 				  docstring));
 
+      docstring =
+	"\n"
+	"    Create several operational points evaluated together.\n"
+	"    \n"
+	"      Input: \n"
+	"        - a string: whitespace separated pairs of operational point\n"
+	"          name and joint name, e.g. \"rleg right-ankle lleg left-ankle\".\n"
+	"\n"
+	"      For each pair, signals <name> and J<name> (and dJv<name>, see\n"
+	"      setOpPointDrift) are created as with createOpPoint.\n"
+	"\n";
+      addCommand("createOpPoints",
+		 makeCommandVoid1(*this,&Dynamic::cmd_createOpPointsSignals,
+				  docstring));
+
       docstring = docCommandVoid2("Create a jacobian (world frame) signal only for one joint.",
 				  "string (signal name)","string (joint name)");
       addCommand("createJacobian",
@@ -242,6 +416,24 @@ Dynamic( const std::string & name, bool build )
 		 makeCommandVoid2(*this,&Dynamic::cmd_createJacobianEndEffectorSignal,
 				  docstring));
 
+      docstring = docCommandVoid2("Create a jacobian (world frame) signal storing only the columns of the joints from the root to this joint.",
+				  "string (signal name)","string (joint name)");
+      addCommand("createSparseJacobian",
+		 makeCommandVoid2(*this,&Dynamic::cmd_createSparseJacobianSignal,
+				  docstring));
+
+      docstring = docCommandVoid2("Create a signal selecting the active dof columns of an existing jacobian signal (see setActiveDofs). It is destroyed together with the jacobian signal.",
+				  "string (signal name)","string (jacobian signal name)");
+      addCommand("createReducedJacobian",
+		 makeCommandVoid2(*this,&Dynamic::cmd_createReducedJacobianSignal,
+				  docstring));
+
+      docstring = docCommandVoid2("Create the signals <name> (center of mass) and J<name> (its jacobian) of the bodies of the subtrees rooted at the given joints.",
+				  "string (signal name)","string (joint names, separated by spaces)");
+      addCommand("createSubtreeCom",
+		 makeCommandVoid2(*this,&Dynamic::cmd_createSubtreeComSignals,
+				  docstring));
+
       docstring = docCommandVoid2("Create a position (matrix homo) signal only for one joint.",
 				  "string (signal name)","string (joint name)");
       addCommand("createPosition",
@@ -404,6 +596,26 @@ Dynamic( const std::string & name, bool build )
     addCommand("getDimension",
 	       new command::GetDimension(*this, docstring));
 
+    docstring = "    \n"
+      "    Get the joint metadata table.\n"
+      "    \n"
+      "      Return:\n"
+      "        a matrix with one row per joint, in the order of getJointNames:\n"
+      "        rank in the configuration, number of dofs, and row of the\n"
+      "        parent joint (-1 for the root).\n"
+      "    \n";
+    addCommand("getJointTable",
+	       new command::GetJointTable(*this, docstring));
+
+    docstring = "    \n"
+      "    Get the names of the joints.\n"
+      "    \n"
+      "      Return:\n"
+      "        a string: the joint names separated by spaces.\n"
+      "    \n";
+    addCommand("getJointNames",
+	       new command::GetJointNames(*this, docstring));
+
     docstring = "    \n"
       "    Write the robot kinematic chain in a file.\n"
       "    \n"
@@ -433,6 +645,145 @@ Dynamic( const std::string & name, bool build )
 	       new dynamicgraph::command::Getter<Dynamic, ml::Vector>
 	       (*this, &Dynamic::getAnklePositionInFootFrame, docstring));
 
+    docstring = "    \n"
+      "    Get the statistics of the jacobian cache.\n"
+      "    \n"
+      "      Return\n"
+      "        - a vector: number of cache hits, number of cache misses.\n"
+      "    \n";
+    addCommand("getJacobianCacheStatistics",
+	       new dynamicgraph::command::Getter<Dynamic, ml::Vector>
+	       (*this, &Dynamic::getJacobianCacheStatistics, docstring));
+
+    docstring = "    \n"
+      "    Reset the statistics of the jacobian cache.\n"
+      "    \n";
+    addCommand("resetJacobianCacheStatistics",
+	       dynamicgraph::command::makeCommandVoid0
+	       (*this, &Dynamic::resetJacobianCacheStatistics, docstring));
+
+    docstring = "    \n"
+      "    Compute the position and end-effector jacobian signals in\n"
+      "    parallel.\n"
+      "    \n"
+      "      Input\n"
+      "        - an unsigned integer: the number of worker threads, 0 to\n"
+      "          compute the signals one at a time (default).\n"
+      "    \n"
+      "      The first of these signals read at a new time computes the\n"
+      "      others. The calls to jrl-dynamics stay in the calling thread:\n"
+      "      the workers only compose the per-joint results.\n"
+      "    \n";
+    addCommand("setParallelSignals",
+	       new dynamicgraph::command::Setter<Dynamic, unsigned int>
+	       (*this, &Dynamic::setParallelSignals, docstring));
+
+    docstring = "    \n"
+      "    Get the number of worker threads of the joint signals.\n"
+      "    \n";
+    addCommand("getParallelSignals",
+	       new dynamicgraph::command::Getter<Dynamic, unsigned int>
+	       (*this, &Dynamic::getParallelSignals, docstring));
+
+    docstring = "    \n"
+      "    Also create the signal dJv<name> of the operational points.\n"
+      "    \n"
+      "      Input\n"
+      "        - a boolean: when true, createOpPoint and createOpPoints\n"
+      "          also create dJv<name>, the product dJ/dt.dq of the\n"
+      "          jacobian J<name> (false by default).\n"
+      "    \n";
+    addCommand("setOpPointDrift",
+	       new dynamicgraph::command::Setter<Dynamic, bool>
+	       (*this, &Dynamic::setOpPointDrift, docstring));
+
+    docstring = "    \n"
+      "    Tell whether createOpPoint creates the signal dJv<name>.\n"
+      "    \n";
+    addCommand("getOpPointDrift",
+	       new dynamicgraph::command::Getter<Dynamic, bool>
+	       (*this, &Dynamic::getOpPointDrift, docstring));
+
+    docstring = "    \n"
+      "    Select the active degrees of freedom.\n"
+      "    \n"
+      "      Input\n"
+      "        - a vector of the size of the configuration: 0 for a locked\n"
+      "          dof, any other value for an active one. An empty vector\n"
+      "          makes all dofs active.\n"
+      "    \n"
+      "      inertiaReduced, JcomReduced, dynamicDriftReduced and the\n"
+      "      signals created by createReducedJacobian only keep the rows and\n"
+      "      columns of the active dofs.\n"
+      "    \n";
+    addCommand("setActiveDofs",
+	       new dynamicgraph::command::Setter<Dynamic, ml::Vector>
+	       (*this, &Dynamic::setActiveDofs, docstring));
+
+    docstring = "    \n"
+      "    Get the active dof mask (see setActiveDofs).\n"
+      "    \n";
+    addCommand("getActiveDofs",
+	       new dynamicgraph::command::Getter<Dynamic, ml::Vector>
+	       (*this, &Dynamic::getActiveDofs, docstring));
+
+    docstring = "    \n"
+      "    Set the tolerance under which two configurations are considered\n"
+      "    equal by the inertia cache.\n"
+      "    \n"
+      "      Input\n"
+      "        - a double: largest difference on each coordinate, 0 for\n"
+      "          an exact comparison (default).\n"
+      "    \n";
+    addCommand("setInertiaTolerance",
+	       new dynamicgraph::command::Setter<Dynamic, double>
+	       (*this, &Dynamic::setInertiaTolerance, docstring));
+
+    docstring = "    \n"
+      "    Get the tolerance of the inertia cache.\n"
+      "    \n";
+    addCommand("getInertiaTolerance",
+	       new dynamicgraph::command::Getter<Dynamic, double>
+	       (*this, &Dynamic::getInertiaTolerance, docstring));
+
+    docstring = "    \n"
+      "    Set the layout of the inertiaPacked output, the inertia output\n"
+      "    stays the full matrix.\n"
+      "    \n"
+      "      Input\n"
+      "        - a string: dense (default), packedUpper (column of the\n"
+      "          upper triangle stored column by column, as read by\n"
+      "          dpptrf) or lowerColumnMajor (matrix stored as the lower\n"
+      "          triangle column-major, as read by dpotrf).\n"
+      "    \n";
+    addCommand("setInertiaLayout",
+	       new dynamicgraph::command::Setter<Dynamic, std::string>
+	       (*this, &Dynamic::setInertiaLayout, docstring));
+
+    docstring = "    \n"
+      "    Get the layout of the inertiaPacked output.\n"
+      "    \n";
+    addCommand("getInertiaLayout",
+	       new dynamicgraph::command::Getter<Dynamic, std::string>
+	       (*this, &Dynamic::getInertiaLayout, docstring));
+
+    docstring = "    \n"
+      "    Get the statistics of the inertia cache.\n"
+      "    \n"
+      "      Return\n"
+      "        - a vector: number of cache hits, number of cache misses.\n"
+      "    \n";
+    addCommand("getInertiaCacheStatistics",
+	       new dynamicgraph::command::Getter<Dynamic, ml::Vector>
+	       (*this, &Dynamic::getInertiaCacheStatistics, docstring));
+
+    docstring = "    \n"
+      "    Reset the statistics of the inertia cache.\n"
+      "    \n";
+    addCommand("resetInertiaCacheStatistics",
+	       dynamicgraph::command::makeCommandVoid0
+	       (*this, &Dynamic::resetInertiaCacheStatistics, docstring));
+
     docstring = "    \n"
       "    Get geometric parameters of hand.\n"
       "    \n"
@@ -481,6 +832,8 @@ Dynamic::
       SignalBase<int>* sigPtr = *iter;
       delete sigPtr;
     }
+  delete tree_;
+  delete workerPool_;
 
   sotDEBUGOUT(5);
   return;
@@ -568,31 +921,101 @@ void Dynamic::parseConfigFiles()
   CHECK_FILE (xmlRankPath, "XML rank file");
   CHECK_FILE (xmlSpecificityFile, "XML specificity file");
 
-  try
-    {
-      sotDEBUG(35) << "Parse the vrml."<<endl;
 #if BOOST_VERSION < 104600
-      std::string robotModelPathStr (robotModelPath.file_string());
-      std::string xmlRankPathStr (xmlRankPath.file_string());
-      std::string xmlSpecificityPathStr (xmlSpecificityPath.file_string());
+  std::string robotModelPathStr (robotModelPath.file_string());
+  std::string xmlRankPathStr (xmlRankPath.file_string());
+  std::string xmlSpecificityPathStr (xmlSpecificityPath.file_string());
 #else
-      std::string robotModelPathStr (robotModelPath.string());
-      std::string xmlRankPathStr (xmlRankPath.string());
-      std::string xmlSpecificityPathStr (xmlSpecificityPath.string());
+  std::string robotModelPathStr (robotModelPath.string());
+  std::string xmlRankPathStr (xmlRankPath.string());
+  std::string xmlSpecificityPathStr (xmlSpecificityPath.string());
 #endif //BOOST_VERSION < 104600
 
-      djj::parseOpenHRPVRMLFile (*m_HDR,
-				 robotModelPathStr,
-				 xmlRankPathStr,
-				 xmlSpecificityPathStr);
+  /* The cache is keyed by the contents of the files, so that it is
+   * reused wherever they are and rebuilt whenever they change. */
+  std::vector<ModelCache::Hash> hashes( 3 );
+  const bool hashed = ModelCache::hashFile( robotModelPathStr,hashes[0] )
+    && ModelCache::hashFile( xmlRankPathStr,hashes[1] )
+    && ModelCache::hashFile( xmlSpecificityPathStr,hashes[2] );
+  const bool useCache = hashed && (! modelCacheDirectory_.empty());
+  const std::string cacheFile
+    = useCache ? ModelCache::fileName( modelCacheDirectory_,hashes ) : "";
+
+  /* Entities parsing the same files in this process share the parsed
+   * description: only the first one reads the files, the others replay
+   * it into their own robot. */
+  bool cached = false;
+  sharedDescription_.reset();
+  if( hashed )
+    {
+      boost::shared_ptr<const ModelDescription> shared = ModelCache::shared( hashes );
+      if( 0!=shared )
+	{
+	  sotDEBUG(35) << "Replay the model parsed by another entity." << endl;
+	  cached = replayModelDescription( *shared );
+	  if( cached ) sharedDescription_ = shared;
+	  else createRobot();
+	}
+    }
+
+  if( (! cached)&&useCache )
+    {
+      ModelDescription model;
+      if( ModelCache::load( cacheFile,hashes,model ) )
+	{
+	  sotDEBUG(35) << "Read the model from " << cacheFile << endl;
+	  cached = replayModelDescription( model );
+	  if( cached ) sharedDescription_ = ModelCache::share( hashes,model );
+	  else createRobot();
+	}
     }
-  catch (...)
+
+  if(! cached )
     {
-      SOT_THROW ExceptionDynamic( ExceptionDynamic::DYNAMIC_JRL,
-				  "Error while parsing." );
+      try
+	{
+	  sotDEBUG(35) << "Parse the vrml."<<endl;
+	  djj::parseOpenHRPVRMLFile (*m_HDR,
+				     robotModelPathStr,
+				     xmlRankPathStr,
+				     xmlSpecificityPathStr);
+	}
+      catch (...)
+	{
+	  SOT_THROW ExceptionDynamic( ExceptionDynamic::DYNAMIC_JRL,
+				      "Error while parsing." );
+	}
+
+      /* A cache that cannot be written is not an error. */
+      ModelDescription model;
+      if( hashed && model.capture( *m_HDR ) )
+	{
+	  sharedDescription_ = ModelCache::share( hashes,model );
+	  if( useCache )
+	    {
+	      try { boost::filesystem::create_directories( modelCacheDirectory_ ); }
+	      catch (...) {}
+	      if(! ModelCache::save( cacheFile,hashes,model ) )
+		{ sotDEBUG(5) << "Cannot write " << cacheFile << endl; }
+	    }
+	}
     }
 
+  invalidateJointRegistry();
   init = true;
+
+  /* Entities parsing the same files share the static data of their tree
+   * (see RigidBodyTree). The dates tell apart two versions of a file,
+   * when the contents could not be hashed. */
+  std::ostringstream key;
+  if( hashed )
+    key << std::hex << hashes[0] << ';' << hashes[1] << ';' << hashes[2];
+  else
+    key << robotModelPath << ':' << boost::filesystem::last_write_time(robotModelPath)
+	<< ';' << xmlRankPath << ':' << boost::filesystem::last_write_time(xmlRankPath)
+	<< ';' << xmlSpecificityPath << ':'
+	<< boost::filesystem::last_write_time(xmlSpecificityPath);
+  modelKey_ = key.str();
   sotDEBUGOUT(15);
 }
 
@@ -601,17 +1024,63 @@ void Dynamic::parseConfigFiles()
 /* --- SIGNAL ACTIVATION ---------------------------------------------------- */
 /* --- SIGNAL ACTIVATION ---------------------------------------------------- */
 /* --- SIGNAL ACTIVATION ---------------------------------------------------- */
+void Dynamic::
+registerGenericSignal( const std::string& signame,SignalBase<int>* sig )
+{
+  /* Registration throws on a duplicate name: index the signal only once
+   * it is registered, so that the live signal of that name is kept. */
+  try { signalRegistration( *sig ); }
+  catch (...) { delete sig; throw; }
+  genericSignalRefs.push_back( sig );
+  genericSignalIndex_[signame] = --genericSignalRefs.end();
+}
+
+Dynamic::GenericSignalHandle Dynamic::
+genericSignalHandle( const std::string& signame,const char* kind )
+{
+  boost::unordered_map<std::string,GenericSignalHandle>::iterator it
+    = genericSignalIndex_.find( signame );
+  if( it==genericSignalIndex_.end() )
+    {
+      SOT_THROW ExceptionDynamic( ExceptionDynamic::CANT_DESTROY_SIGNAL,
+				  getName() + ":cannot destroy signal",
+				  " (while trying to remove generic %s signal <%s>).",
+				  kind,signame.c_str() );
+    }
+  return it->second;
+}
+
+void Dynamic::
+releaseGenericSignal( const std::string& signame,GenericSignalHandle handle )
+{
+  /* The reduced jacobians depend on the signal: remove them first. */
+  reducedJacobianSources_.erase( signame );
+  std::vector<std::string> reduced;
+  for( std::map<std::string,std::string>::const_iterator
+	 it = reducedJacobianSources_.begin();
+       it!=reducedJacobianSources_.end();++it )
+    if( it->second==signame ) reduced.push_back( it->first );
+  for( unsigned int i=0;i<reduced.size();++i )
+    releaseGenericSignal( reduced[i],genericSignalHandle( reduced[i],"jac." ) );
+
+  SignalBase<int>* sig = *handle;
+  signalDeregistration( signame );
+  genericSignalIndex_.erase( signame );
+  if( parallelSignals_.erase( signame )>0 ) parallelTasksReady_ = false;
+  genericSignalRefs.erase( handle );
+  delete sig;
+}
+
 dg::SignalTimeDependent< ml::Matrix,int > & Dynamic::
 createJacobianSignal( const std::string& signame, CjrlJoint* aJoint )
 {
   dg::SignalTimeDependent< ml::Matrix,int > * sig
     = new dg::SignalTimeDependent< ml::Matrix,int >
     ( boost::bind(&Dynamic::computeGenericJacobian,this,aJoint,_1,_2),
-      newtonEulerSINTERN,
+      kinematicsSINTERN,
       "sotDynamic("+name+")::output(matrix)::"+signame );
 
-  genericSignalRefs.push_back( sig );
-  signalRegistration( *sig );
+  registerGenericSignal( signame,sig );
   return *sig;
 }
 
@@ -619,15 +1088,17 @@ dg::SignalTimeDependent< ml::Matrix,int > & Dynamic::
 createEndeffJacobianSignal( const std::string& signame, CjrlJoint* aJoint )
 {
   sotDEBUGIN(15);
+  /* Precompute the static data of the joint. */
+  jointCache( aJoint );
 
   dg::SignalTimeDependent< ml::Matrix,int > * sig
     = new dg::SignalTimeDependent< ml::Matrix,int >
     ( boost::bind(&Dynamic::computeGenericEndeffJacobian,this,aJoint,_1,_2),
-      newtonEulerSINTERN,
+      kinematicsSINTERN,
       "sotDynamic("+name+")::output(matrix)::"+signame );
 
-  genericSignalRefs.push_back( sig );
-  signalRegistration( *sig );
+  registerGenericSignal( signame,sig );
+  registerParallelSignal( signame,aJoint,true );
 
   sotDEBUGOUT(15);
   return *sig;
@@ -636,26 +1107,143 @@ createEndeffJacobianSignal( const std::string& signame, CjrlJoint* aJoint )
 void Dynamic::
 destroyJacobianSignal( const std::string& signame )
 {
-  bool deletable = false;
-  dg::SignalTimeDependent< ml::Matrix,int > * sig = & jacobiansSOUT( signame );
-  for(  std::list< SignalBase<int>* >::iterator iter = genericSignalRefs.begin();
-	iter != genericSignalRefs.end();
-	++iter )
+  GenericSignalHandle handle = genericSignalHandle( signame,"jac." );
+  if( 0==dynamic_cast< dg::SignalTimeDependent< ml::Matrix,int >* >( *handle ) )
+    {
+      SOT_THROW ExceptionSignal( ExceptionSignal::BAD_CAST,
+				 "Impossible cast.",
+				 " (while getting signal <%s> of type matrix.",
+				 signame.c_str());
+    }
+  releaseGenericSignal( signame,handle );
+}
+
+dg::SignalTimeDependent< SparseJacobian,int > & Dynamic::
+createSparseJacobianSignal( const std::string& signame, CjrlJoint* aJoint )
+{
+  sotDEBUGIN(15);
+
+  dg::SignalTimeDependent< SparseJacobian,int > * sig
+    = new dg::SignalTimeDependent< SparseJacobian,int >
+    ( boost::bind(&Dynamic::computeGenericSparseJacobian,this,aJoint,_1,_2),
+      kinematicsSINTERN,
+      "sotDynamic("+name+")::output(sparsejacobian)::"+signame );
+
+  registerGenericSignal( signame,sig );
+
+  sotDEBUGOUT(15);
+  return *sig;
+}
+
+void Dynamic::
+destroySparseJacobianSignal( const std::string& signame )
+{
+  GenericSignalHandle handle = genericSignalHandle( signame,"sparse jac." );
+  if( 0==dynamic_cast< dg::SignalTimeDependent< SparseJacobian,int >* >( *handle ) )
+    {
+      SOT_THROW ExceptionSignal( ExceptionSignal::BAD_CAST,
+				 "Impossible cast.",
+				 " (while getting signal <%s> of type sparse jacobian.",
+				 signame.c_str());
+    }
+  releaseGenericSignal( signame,handle );
+}
+
+void Dynamic::
+createSubtreeComSignals( const std::string& signame,
+			 const std::vector<CjrlJoint*>& roots )
+{
+  sotDEBUGIN(15);
+
+  comGroups_.push_back( ComGroup() );
+  ComGroup& group = comGroups_.back();
+  group.name = signame;
+  group.roots = roots;
+
+  dg::SignalTimeDependent< ml::Vector,int > * com
+    = new dg::SignalTimeDependent< ml::Vector,int >
+    ( boost::bind(&Dynamic::computeGroupCom,this,&group,_1,_2),
+      comSINTERN,
+      "sotDynamic("+name+")::output(vector)::"+signame );
+  dg::SignalTimeDependent< ml::Matrix,int > * Jcom
+    = new dg::SignalTimeDependent< ml::Matrix,int >
+    ( boost::bind(&Dynamic::computeGroupJcom,this,&group,_1,_2),
+      comSINTERN,
+      "sotDynamic("+name+")::output(matrix)::J"+signame );
+
+  /* On a duplicate name, leave no partial group behind. */
+  try { registerGenericSignal( signame,com ); }
+  catch (...) { delete Jcom; comGroups_.pop_back(); throw; }
+  try { registerGenericSignal( "J"+signame,Jcom ); }
+  catch (...)
     {
-      if( (*iter) == sig ) { genericSignalRefs.erase(iter); deletable = true; break; }
+      releaseGenericSignal( signame,genericSignalHandle( signame,"com" ) );
+      comGroups_.pop_back();
+      throw;
     }
 
-  if(! deletable )
+  sotDEBUGOUT(15);
+}
+
+void Dynamic::
+destroySubtreeComSignals( const std::string& signame )
+{
+  std::list<ComGroup>::iterator group = comGroups_.begin();
+  for( ++group;group!=comGroups_.end();++group )
+    if( group->name==signame ) break;
+  if( group==comGroups_.end() )
     {
       SOT_THROW ExceptionDynamic( ExceptionDynamic::CANT_DESTROY_SIGNAL,
-				     "Cannot destroy signal",
-				     " (while trying to remove generic jac. signal <%s>).",
-				     signame.c_str() );
+				  getName() + ":cannot destroy signal",
+				  " (while trying to remove subtree com signal <%s>).",
+				  signame.c_str() );
     }
 
-  signalDeregistration( signame );
+  GenericSignalHandle com = genericSignalHandle( signame,"com" );
+  GenericSignalHandle Jcom = genericSignalHandle( "J"+signame,"jac." );
+  releaseGenericSignal( signame,com );
+  releaseGenericSignal( "J"+signame,Jcom );
+  comGroups_.erase( group );
+}
 
-  delete sig;
+void Dynamic::
+createOpPointSignals( const std::vector<std::string>& opPointNames,
+		      const std::vector<CjrlJoint*>& joints )
+{
+  sotDEBUGIN(15);
+
+  /* The signals of the op points share the forward kinematics pass and
+   * the per-joint cache: a joint used by several op points is computed
+   * once per tick. */
+  for( unsigned int i=0;i<opPointNames.size();++i )
+    {
+      createEndeffJacobianSignal( "J"+opPointNames[i],joints[i] );
+      createPositionSignal( opPointNames[i],joints[i] );
+      if( opPointDrift_ )
+	createJacobianDriftSignal( "dJv"+opPointNames[i],joints[i] );
+    }
+
+  sotDEBUGOUT(15);
+}
+
+dg::SignalTimeDependent< ml::Matrix,int > & Dynamic::
+createReducedJacobianSignal( const std::string& signame,
+			     const std::string& jacobianName )
+{
+  sotDEBUGIN(15);
+
+  dg::SignalTimeDependent< ml::Matrix,int > * J = & jacobiansSOUT( jacobianName );
+  dg::SignalTimeDependent< ml::Matrix,int > * sig
+    = new dg::SignalTimeDependent< ml::Matrix,int >
+    ( boost::bind(&Dynamic::computeReducedJacobian,this,J,_1,_2),
+      *J,
+      "sotDynamic("+name+")::output(matrix)::"+signame );
+
+  registerGenericSignal( signame,sig );
+  reducedJacobianSources_[signame] = jacobianName;
+
+  sotDEBUGOUT(15);
+  return *sig;
 }
 
 /* --- POINT --- */
@@ -666,15 +1254,17 @@ dg::SignalTimeDependent< MatrixHomogeneous,int >& Dynamic::
 createPositionSignal( const std::string& signame, CjrlJoint* aJoint)
 {
   sotDEBUGIN(15);
+  /* Precompute the static data of the joint. */
+  jointCache( aJoint );
 
   dg::SignalTimeDependent< MatrixHomogeneous,int > * sig
     = new dg::SignalTimeDependent< MatrixHomogeneous,int >
     ( boost::bind(&Dynamic::computeGenericPosition,this,aJoint,_1,_2),
-      newtonEulerSINTERN,
+      kinematicsSINTERN,
       "sotDynamic("+name+")::output(matrixHomo)::"+signame );
 
-  genericSignalRefs.push_back( sig );
-  signalRegistration( *sig );
+  registerGenericSignal( signame,sig );
+  registerParallelSignal( signame,aJoint,false );
 
   sotDEBUGOUT(15);
   return *sig;
@@ -684,26 +1274,15 @@ createPositionSignal( const std::string& signame, CjrlJoint* aJoint)
 void Dynamic::
 destroyPositionSignal( const std::string& signame )
 {
-  bool deletable = false;
-  dg::SignalTimeDependent< MatrixHomogeneous,int > * sig = & positionsSOUT( signame );
-  for(  std::list< SignalBase<int>* >::iterator iter = genericSignalRefs.begin();
-	iter != genericSignalRefs.end();
-	++iter )
-    {
-      if( (*iter) == sig ) { genericSignalRefs.erase(iter); deletable = true; break; }
-    }
-
-  if(! deletable )
+  GenericSignalHandle handle = genericSignalHandle( signame,"pos." );
+  if( 0==dynamic_cast< dg::SignalTimeDependent< MatrixHomogeneous,int >* >( *handle ) )
     {
-      SOT_THROW ExceptionDynamic( ExceptionDynamic::CANT_DESTROY_SIGNAL,
-				     "Cannot destroy signal",
-				     " (while trying to remove generic pos. signal <%s>).",
-				     signame.c_str() );
+      SOT_THROW ExceptionSignal( ExceptionSignal::BAD_CAST,
+				 "Impossible cast.",
+				 " (while getting signal <%s> of type matrixHomo.",
+				 signame.c_str());
     }
-
-  signalDeregistration( signame );
-
-  delete sig;
+  releaseGenericSignal( signame,handle );
 }
 
 /* --- VELOCITY --- */
@@ -717,10 +1296,9 @@ createVelocitySignal( const std::string& signame, CjrlJoint* aJoint )
   SignalTimeDependent< ml::Vector,int > * sig
     = new SignalTimeDependent< ml::Vector,int >
     ( boost::bind(&Dynamic::computeGenericVelocity,this,aJoint,_1,_2),
-      newtonEulerSINTERN,
+      velocityKinematicsSINTERN,
       "sotDynamic("+name+")::output(ml::Vector)::"+signame );
-  genericSignalRefs.push_back( sig );
-  signalRegistration( *sig );
+  registerGenericSignal( signame,sig );
 
   sotDEBUGOUT(15);
   return *sig;
@@ -730,26 +1308,15 @@ createVelocitySignal( const std::string& signame, CjrlJoint* aJoint )
 void Dynamic::
 destroyVelocitySignal( const std::string& signame )
 {
-  bool deletable = false;
-  SignalTimeDependent< ml::Vector,int > * sig = & velocitiesSOUT( signame );
-  for(  std::list< SignalBase<int>* >::iterator iter = genericSignalRefs.begin();
-	iter != genericSignalRefs.end();
-	++iter )
-    {
-      if( (*iter) == sig ) { genericSignalRefs.erase(iter); deletable = true; break; }
-    }
-
-  if(! deletable )
+  GenericSignalHandle handle = genericSignalHandle( signame,"vel." );
+  if( 0==dynamic_cast< dg::SignalTimeDependent< ml::Vector,int >* >( *handle ) )
     {
-      SOT_THROW ExceptionDynamic( ExceptionDynamic::CANT_DESTROY_SIGNAL,
-				     "Cannot destroy signal",
-				     " (while trying to remove generic pos. signal <%s>).",
-				     signame.c_str() );
+      SOT_THROW ExceptionSignal( ExceptionSignal::BAD_CAST,
+				 "Impossible cast.",
+				 " (while getting signal <%s> of type Vector.",
+				 signame.c_str());
     }
-
-  signalDeregistration( signame );
-
-  delete sig;
+  releaseGenericSignal( signame,handle );
 }
 
 /* --- ACCELERATION --- */
@@ -766,8 +1333,7 @@ createAccelerationSignal( const std::string& signame, CjrlJoint* aJoint )
       newtonEulerSINTERN,
       "sotDynamic("+name+")::output(matrixHomo)::"+signame );
 
-  genericSignalRefs.push_back( sig );
-  signalRegistration( *sig );
+  registerGenericSignal( signame,sig );
 
   sotDEBUGOUT(15);
   return *sig;
@@ -777,28 +1343,64 @@ createAccelerationSignal( const std::string& signame, CjrlJoint* aJoint )
 void Dynamic::
 destroyAccelerationSignal( const std::string& signame )
 {
-  bool deletable = false;
-  dg::SignalTimeDependent< ml::Vector,int > * sig = & accelerationsSOUT( signame );
-  for(  std::list< SignalBase<int>* >::iterator iter = genericSignalRefs.begin();
-	iter != genericSignalRefs.end();
-	++iter )
+  GenericSignalHandle handle = genericSignalHandle( signame,"acc." );
+  if( 0==dynamic_cast< dg::SignalTimeDependent< ml::Vector,int >* >( *handle ) )
     {
-      if( (*iter) == sig ) { genericSignalRefs.erase(iter); deletable = true; break; }
+      SOT_THROW ExceptionSignal( ExceptionSignal::BAD_CAST,
+				 "Impossible cast.",
+				 " (while getting signal <%s> of type Vector.",
+				 signame.c_str());
     }
+  releaseGenericSignal( signame,handle );
+}
+/* --- JACOBIAN DRIFT --- */
+/* --- JACOBIAN DRIFT --- */
+/* --- JACOBIAN DRIFT --- */
 
-  if(! deletable )
-    {
-      SOT_THROW ExceptionDynamic( ExceptionDynamic::CANT_DESTROY_SIGNAL,
-				  getName() + ":cannot destroy signal",
-				  " (while trying to remove generic acc "
-				  "signal <%s>).",
-				  signame.c_str() );
-    }
+dg::SignalTimeDependent< ml::Vector,int >& Dynamic::
+createJacobianDriftSignal( const std::string& signame, CjrlJoint* aJoint )
+{
+  sotDEBUGIN(15);
+  /* The index is resolved against the current tree, if built, and again
+   * after each build. */
+  DriftTarget target;
+  target.signame = signame;
+  target.joint = aJoint;
+  target.treeBuild = tree_->buildCount();
+  target.index = tree_->ready() ? tree_->index(aJoint) : -1;
+  std::list<DriftTarget>::iterator it
+    = driftTargets_.insert( driftTargets_.end(),target );
 
-  signalDeregistration( signame );
+  dg::SignalTimeDependent< ml::Vector,int > * sig
+    = new dg::SignalTimeDependent< ml::Vector,int >
+    ( boost::bind(&Dynamic::computeGenericJacobianDrift,this,&*it,_1,_2),
+      treeVelocitySINTERN,
+      "sotDynamic("+name+")::output(vector)::"+signame );
 
-  delete sig;
+  try { registerGenericSignal( signame,sig ); }
+  catch (...) { driftTargets_.erase( it ); throw; }
+
+  sotDEBUGOUT(15);
+  return *sig;
+}
+
+void Dynamic::
+destroyJacobianDriftSignal( const std::string& signame )
+{
+  GenericSignalHandle handle = genericSignalHandle( signame,"drift" );
+  if( 0==dynamic_cast< dg::SignalTimeDependent< ml::Vector,int >* >( *handle ) )
+    {
+      SOT_THROW ExceptionSignal( ExceptionSignal::BAD_CAST,
+				 "Impossible cast.",
+				 " (while getting signal <%s> of type Vector.",
+				 signame.c_str());
+    }
+  releaseGenericSignal( signame,handle );
+  for( std::list<DriftTarget>::iterator it = driftTargets_.begin();
+       it!=driftTargets_.end();++it )
+    if( it->signame==signame ) { driftTargets_.erase( it ); break; }
 }
+
 /* --- COMPUTE -------------------------------------------------------------- */
 /* --- COMPUTE -------------------------------------------------------------- */
 /* --- COMPUTE -------------------------------------------------------------- */
@@ -814,49 +1416,244 @@ static void MAAL1_V3d_to_MAAL2( const vector3d& source,
   res(2) = source[2];
 }
 
-ml::Matrix& Dynamic::
-computeGenericJacobian( CjrlJoint * aJoint,ml::Matrix& res,int time )
+Dynamic::JointCache::
+JointCache()
+  :jacobianStage(0)
+  ,positionStage(0)
+  ,position()
+  ,endeffStage(0)
+  ,endeffJacobian()
+  ,transformation()
+  ,jacobian(0)
+  ,supportReady(false)
+  ,support()
+  ,jacobianHits(0)
+  ,jacobianMisses(0)
+{}
+
+Dynamic::JointCache& Dynamic::
+jointCache( CjrlJoint* aJoint )
+{
+  std::map<CjrlJoint*,JointCache>::iterator it = jointCache_.find(aJoint);
+  if( it==jointCache_.end() )
+    {
+      it = jointCache_.insert( std::make_pair(aJoint,JointCache()) ).first;
+      computeFrameCorrection( aJoint,it->second.correction );
+    }
+  return it->second;
+}
+
+const matrixNxP& Dynamic::
+jointJacobian( CjrlJoint* aJoint )
+{
+  JointCache& cache = jointCache(aJoint);
+  if( cache.jacobianStage==stageCount_ )
+    { ++cache.jacobianHits; }
+  else
+    {
+      ++cache.jacobianMisses;
+      computeJointJacobian( aJoint );
+      cache.jacobianStage = stageCount_;
+    }
+  return aJoint->jacobianJointWrtConfig();
+}
+
+const MatrixHomogeneous& Dynamic::
+jointPosition( CjrlJoint* aJoint )
+{
+  JointCache& cache = jointCache(aJoint);
+  if( cache.positionStage!=stageCount_ )
+    {
+      composeJointPosition( aJoint->currentTransformation(),cache.correction,
+			    cache.position );
+      cache.positionStage = stageCount_;
+    }
+  return cache.position;
+}
+
+const std::vector<unsigned int>& Dynamic::
+jointSupport( CjrlJoint* aJoint )
+{
+  JointCache& cache = jointCache(aJoint);
+  if(! cache.supportReady )
+    {
+      const std::vector<CjrlJoint*> chain = aJoint->jointsFromRootToThis();
+      cache.support.clear();
+      for( unsigned int i=0;i<chain.size();++i )
+	{
+	  const unsigned int rank = chain[i]->rankInConfiguration();
+	  for( unsigned int k=0;k<chain[i]->numberDof();++k )
+	    cache.support.push_back(rank+k);
+	}
+      std::sort( cache.support.begin(),cache.support.end() );
+      cache.supportReady = true;
+    }
+  return cache.support;
+}
+
+void Dynamic::
+registerParallelSignal( const std::string& signame,CjrlJoint* joint,
+			const bool endeff )
+{
+  parallelSignals_[signame] = std::make_pair( joint,endeff );
+  parallelTasksReady_ = false;
+}
+
+void Dynamic::
+buildParallelTasks( void )
+{
+  parallelJoints_.clear();
+  for( boost::unordered_map< std::string,std::pair<CjrlJoint*,bool> >::const_iterator
+	 it = parallelSignals_.begin();
+       it!=parallelSignals_.end();++it )
+    {
+      CjrlJoint* joint = it->second.first;
+      unsigned int i=0;
+      while( (i<parallelJoints_.size())&&(parallelJoints_[i].joint!=joint) ) ++i;
+      if( i==parallelJoints_.size() )
+	{
+	  parallelJoints_.push_back( ParallelJoint() );
+	  parallelJoints_.back().joint = joint;
+	  parallelJoints_.back().endeff = false;
+	  parallelJoints_.back().cache = 0;
+	}
+      if( it->second.second ) parallelJoints_[i].endeff = true;
+    }
+
+  parallelTasks_.clear();
+  for( unsigned int i=0;i<parallelJoints_.size();++i )
+    parallelTasks_.push_back( boost::bind(&Dynamic::runParallelJoint,this,i,_1) );
+  parallelTasksReady_ = true;
+}
+
+/* Everything that touches a signal or the robot of jrl-dynamics is done
+ * here, by the calling thread: the stage, the joint jacobians and the
+ * copy of the joint transformations. The workers only write the cache
+ * entry of their joint, which is created beforehand. */
+void Dynamic::
+prefetchGenericSignals( int time )
+{
+  if( 0==workerPool_ ) return;
+  kinematicsSINTERN(time);
+  if( prefetchStage_==stageCount_ ) return;
+  prefetchStage_ = stageCount_;
+  if(! parallelTasksReady_ ) buildParallelTasks();
+
+  for( unsigned int i=0;i<parallelJoints_.size();++i )
+    {
+      ParallelJoint& group = parallelJoints_[i];
+      JointCache& cache = jointCache( group.joint );
+      cache.transformation = group.joint->currentTransformation();
+      if( group.endeff )
+	{
+	  cache.jacobian = &jointJacobian( group.joint );
+	  jointSupport( group.joint );
+	}
+      group.cache = &cache;
+    }
+
+  std::string error;
+  if(! workerPool_->run( parallelTasks_,time,error ) )
+    {
+      SOT_THROW ExceptionDynamic( ExceptionDynamic::GENERIC,
+				  "Error in the parallel computation of the joint signals",
+				  " (%s).",error.c_str() );
+    }
+}
+
+void Dynamic::
+runParallelJoint( unsigned int index,int )
+{
+  const ParallelJoint& group = parallelJoints_[index];
+  JointCache& cache = *group.cache;
+  composeJointPosition( cache.transformation,cache.correction,cache.position );
+  cache.positionStage = prefetchStage_;
+  if( group.endeff )
+    {
+      composeEndeffJacobian( *cache.jacobian,cache.position,cache.support,
+			     cache.endeffJacobian );
+      cache.endeffStage = prefetchStage_;
+    }
+}
+
+ml::Matrix& Dynamic::
+computeGenericJacobian( CjrlJoint * aJoint,ml::Matrix& res,int time )
 {
   sotDEBUGIN(25);
-  newtonEulerSINTERN(time);
+  kinematicsSINTERN(time);
 
-  aJoint->computeJacobianJointWrtConfig();
-  res.initFromMotherLib(aJoint->jacobianJointWrtConfig());
+  res.initFromMotherLib(jointJacobian(aJoint));
   sotDEBUGOUT(25);
 
   return res;
 }
 
+void Dynamic::
+composeEndeffJacobian( const matrixNxP& J,const MatrixHomogeneous& M,
+		       const std::vector<unsigned int>& support,
+		       ml::Matrix& res )
+{
+  /* The support is sorted: the columns in between are zeroed, since it
+   * can change without a resize of res. */
+  const unsigned int NBCOLS = J.size2();
+  if( (res.nbRows()!=6)||(res.nbCols()!=NBCOLS) ) res.resize(6,NBCOLS);
+
+  std::vector<unsigned int>::const_iterator it = support.begin();
+  for( unsigned int c=0;c<NBCOLS;++c )
+    {
+      if( (it==support.end())||(*it!=c) )
+	{
+	  for( unsigned int i=0;i<6;++i ) res(i,c) = 0.;
+	  continue;
+	}
+      ++it;
+      for( unsigned int i=0;i<3;++i )
+	{
+	  res(i,c) = M(0,i)*J(0,c) + M(1,i)*J(1,c) + M(2,i)*J(2,c);
+	  res(i+3,c) = M(0,i)*J(3,c) + M(1,i)*J(4,c) + M(2,i)*J(5,c);
+	}
+    }
+}
+
 ml::Matrix& Dynamic::
 computeGenericEndeffJacobian( CjrlJoint * aJoint,ml::Matrix& res,int time )
 {
   sotDEBUGIN(25);
-  newtonEulerSINTERN(time);
+  prefetchGenericSignals(time);
+  kinematicsSINTERN(time);
 
-  aJoint->computeJacobianJointWrtConfig();
+  /* res = [ R' 0 ; 0 R' ] J, computed only on the columns of the
+   * ancestor chain, unless the workers already did. */
+  const JointCache& cache = jointCache(aJoint);
+  if( cache.endeffStage==stageCount_ ) res = cache.endeffJacobian;
+  else
+    composeEndeffJacobian( jointJacobian(aJoint),jointPosition(aJoint),
+			   jointSupport(aJoint),res );
 
-  ml::Matrix J,V(6,6);
-  J.initFromMotherLib(aJoint->jacobianJointWrtConfig());
+  sotDEBUGOUT(25);
+  return res;
+}
 
-  /* --- TODO --- */
-  MatrixHomogeneous M;
-  computeGenericPosition(aJoint,M,time);
-  //M=M.inverse();
+SparseJacobian& Dynamic::
+computeGenericSparseJacobian( CjrlJoint * aJoint,SparseJacobian& res,int time )
+{
+  sotDEBUGIN(25);
+  kinematicsSINTERN(time);
 
-  for( int i=0;i<3;++i )
-    for( int j=0;j<3;++j )
-      {
-	V(i,j)=M(j,i);
-	V(i+3,j+3)=M(j,i);
-	V(i+3,j)=0.;
-	V(i,j+3)=0.;
-      }
+  const matrixNxP& J = jointJacobian(aJoint);
+  const std::vector<unsigned int>& support = jointSupport(aJoint);
 
-  sotDEBUG(25) << "0Jn = "<< J;
-  sotDEBUG(25) << "V = "<< V;
-  V.multiply(J,res);
-  sotDEBUGOUT(25);
+  /* The support only changes with the model: set it when it differs,
+   * then only copy the nonzero columns. */
+  if( (res.nbCols()!=J.size2())||(res.support()!=support) )
+    res.setSupport( J.size1(),J.size2(),support );
 
+  ml::Matrix& compact = res.compact();
+  for( unsigned int k=0;k<support.size();++k )
+    for( unsigned int i=0;i<J.size1();++i )
+      compact(i,k) = J(i,support[k]);
+
+  sotDEBUGOUT(25);
   return res;
 }
 
@@ -864,52 +1661,47 @@ MatrixHomogeneous& Dynamic::
 computeGenericPosition( CjrlJoint * aJoint,MatrixHomogeneous& res,int time )
 {
   sotDEBUGIN(25);
-  newtonEulerSINTERN(time);
-  const matrix4d & m4 = aJoint->currentTransformation();
-
-  res.resize(4,4);
-  for( int i=0;i<4;++i )
-    for( int j=0;j<4;++j )
-      res(i,j) = MAL_S4x4_MATRIX_ACCESS_I_J(m4,i,j);
-
-  //  aJoint->computeJacobianJointWrtConfig();
-  //res.initFromMotherLib(aJoint->jacobianJointWrtConfig());
-
-  // adaptation to the new dynamic -- to be optimized
-    matrix4d initialTr;
-    initialTr = aJoint->initialPosition();
-    MAL_S4x4_MATRIX_ACCESS_I_J(initialTr,0,3) = 0.0;
-    MAL_S4x4_MATRIX_ACCESS_I_J(initialTr,1,3) = 0.0;
-    MAL_S4x4_MATRIX_ACCESS_I_J(initialTr,2,3) = 0.0;
-
-    matrix4d invrot;
-    for(unsigned int i=0;i<3;i++)
-      for(unsigned int j=0;j<3;j++)
-        {
-  	MAL_S4x4_MATRIX_ACCESS_I_J(invrot,i,j)=0.0;
-  	for(unsigned int k=0;k<3;k++)
-  	  {
-  	    MAL_S4x4_MATRIX_ACCESS_I_J(invrot,i,j)+=
-  	      MAL_S4x4_MATRIX_ACCESS_I_J(res,i,k) *
-  	      MAL_S4x4_MATRIX_ACCESS_I_J(initialTr,j,k);
-  	  }
-        }
-    for(unsigned int i=0;i<3;i++)
-      for(unsigned int j=0;j<3;j++)
-        MAL_S4x4_MATRIX_ACCESS_I_J(res,i,j) =
-  	MAL_S4x4_MATRIX_ACCESS_I_J(invrot,i,j);
-    //end of the adaptation
-
-
+  prefetchGenericSignals(time);
+  kinematicsSINTERN(time);
+  res = jointPosition(aJoint);
   sotDEBUGOUT(25);
   return res;
 }
 
+void Dynamic::
+computeFrameCorrection( CjrlJoint * aJoint,double correction[9] )
+{
+  /* The position output is expressed in the frame of the joint at its
+   * initial position: R = R_current.R_initial'. */
+  const matrix4d & initialTr = aJoint->initialPosition();
+  for( unsigned int k=0;k<3;++k )
+    for( unsigned int j=0;j<3;++j )
+      correction[3*k+j] = MAL_S4x4_MATRIX_ACCESS_I_J(initialTr,j,k);
+}
+
+void Dynamic::
+composeJointPosition( const matrix4d& m4,const double correction[9],
+		      MatrixHomogeneous& res )
+{
+  if( (res.nbRows()!=4)||(res.nbCols()!=4) ) res.resize(4,4);
+  for( unsigned int i=0;i<3;++i )
+    {
+      const double m0 = MAL_S4x4_MATRIX_ACCESS_I_J(m4,i,0);
+      const double m1 = MAL_S4x4_MATRIX_ACCESS_I_J(m4,i,1);
+      const double m2 = MAL_S4x4_MATRIX_ACCESS_I_J(m4,i,2);
+      for( unsigned int j=0;j<3;++j )
+	res(i,j) = m0*correction[j] + m1*correction[3+j] + m2*correction[6+j];
+      res(i,3) = MAL_S4x4_MATRIX_ACCESS_I_J(m4,i,3);
+    }
+  for( unsigned int j=0;j<4;++j )
+    res(3,j) = MAL_S4x4_MATRIX_ACCESS_I_J(m4,3,j);
+}
+
 ml::Vector& Dynamic::
 computeGenericVelocity( CjrlJoint* j,ml::Vector& res,int time )
 {
   sotDEBUGIN(25);
-  newtonEulerSINTERN(time);
+  velocityKinematicsSINTERN(time);
   CjrlRigidVelocity aRV = j->jointVelocity();
   vector3d al= aRV.linearVelocity();
   vector3d ar= aRV.rotationVelocity();
@@ -947,6 +1739,72 @@ computeGenericAcceleration( CjrlJoint* j,ml::Vector& res,int time )
 
 
 
+/* Classical acceleration of the point p at zero joint acceleration, from
+ * the spatial velocity v and velocity-product acceleration c of its
+ * body. */
+static spatial::Vector3 pointDrift( const spatial::Motion& v,
+				    const spatial::Motion& c,
+				    const spatial::Vector3& p )
+{
+  return c.pointVelocity(p) + spatial::cross( v.angular,v.pointVelocity(p) );
+}
+
+ml::Vector& Dynamic::
+computeGenericJacobianDrift( DriftTarget* target,ml::Vector& res,int time )
+{
+  sotDEBUGIN(25);
+  treeVelocitySINTERN(time);
+  if( target->treeBuild!=tree_->buildCount() )
+    {
+      target->index = tree_->index( target->joint );
+      target->treeBuild = tree_->buildCount();
+    }
+  const int index = target->index;
+  if( index<0 )
+    {
+      SOT_THROW ExceptionDynamic( ExceptionDynamic::GENERIC,
+				  getName() +
+				  ": joint not in the kinematic tree." );
+    }
+  const RigidBodyTree::Body& body = (*tree_)[index];
+
+  /* Same frame as the end-effector jacobian. */
+  const spatial::Vector3 a
+    = spatial::transposeMultiply( body.R,pointDrift( body.v,body.c,body.p ) );
+  const spatial::Vector3 dw = spatial::transposeMultiply( body.R,body.c.angular );
+  if( res.size()!=6 ) res.resize(6);
+  for( unsigned int i=0;i<3;++i )
+    {
+      res(i) = a[i];
+      res(i+3) = dw[i];
+    }
+
+  sotDEBUGOUT(25);
+  return res;
+}
+
+ml::Vector& Dynamic::
+computeJcomDrift( ml::Vector& res,int time )
+{
+  sotDEBUGIN(25);
+  treeVelocitySINTERN(time);
+  spatial::Vector3 sum;
+  double mass = 0.;
+  for( unsigned int i=0;i<tree_->size();++i )
+    {
+      const double m = tree_->link(i).mass;
+      if( 0.==m ) continue;
+      const RigidBodyTree::Body& body = (*tree_)[i];
+      sum += m*pointDrift( body.v,body.c,body.com );
+      mass += m;
+    }
+  if( mass>0. ) sum *= 1./mass;
+  if( res.size()!=3 ) res.resize(3);
+  for( unsigned int i=0;i<3;++i ) res(i) = sum[i];
+  sotDEBUGOUT(25);
+  return res;
+}
+
 ml::Vector& Dynamic::
 computeZmp( ml::Vector& ZMPval,int time )
 {
@@ -969,7 +1827,7 @@ computeMomenta(ml::Vector & Momenta, int time)
     Momenta.resize(6);
 
   sotDEBUGIN(25);
-  newtonEulerSINTERN(time);
+  velocityKinematicsSINTERN(time);
   LinearMomentum = m_HDR->linearMomentumRobot();
   AngularMomentum = m_HDR->angularMomentumRobot();
 
@@ -992,7 +1850,7 @@ computeAngularMomentum(ml::Vector & Momenta, int time)
     Momenta.resize(3);
 
   sotDEBUGIN(25);
-  newtonEulerSINTERN(time);
+  velocityKinematicsSINTERN(time);
   AngularMomentum = m_HDR->angularMomentumRobot();
 
   for(unsigned int i=0;i<3;i++)
@@ -1005,17 +1863,123 @@ computeAngularMomentum(ml::Vector & Momenta, int time)
 
 }
 
-ml::Matrix& Dynamic::
-computeJcom( ml::Matrix& Jcom,int time )
+RigidBodyTree& Dynamic::
+kinematicTree( int time )
+{
+  kinematicsSINTERN(time);
+  if(! tree_->ready() )
+    {
+      tree_->build( *m_HDR,modelKey_ );
+      treePositionStage_ = 0;
+      for( std::list<ComGroup>::iterator iter = comGroups_.begin();
+	   iter != comGroups_.end();
+	   ++iter )
+	updateComGroupMembers( *iter );
+    }
+  if( treePositionStage_!=stageCount_ )
+    {
+      tree_->updatePositions();
+      treePositionStage_ = stageCount_;
+    }
+  return *tree_;
+}
+
+void Dynamic::
+updateComGroupMembers( ComGroup& group )
+{
+  const RigidBodyTree& tree = *tree_;
+  const unsigned int NBBODIES = tree.size();
+  group.member.assign( NBBODIES,group.roots.empty() );
+  group.subtreeMass.resize( NBBODIES );
+  group.subtreeMoment.resize( NBBODIES );
+  if( group.roots.empty() ) return;
+
+  /* Parents come first: a body belongs to the group if it is one of the
+   * roots or if its parent does. */
+  for( unsigned int i=0;i<NBBODIES;++i )
+    {
+      const bool isRoot
+	= ( std::find( group.roots.begin(),group.roots.end(),tree[i].joint )
+	    != group.roots.end() );
+      const int parent = tree.link(i).parent;
+      group.member[i] = isRoot || ( (parent>=0)&&group.member[parent] );
+    }
+}
+
+/* The jacobian column of dof k of joint i is the sum, over the bodies j
+ * of the group below i, of m_j.dc_j/dq_k = m_j.( v_k + w_k x c_j ), with
+ * (w_k,v_k) the motion subspace at the world origin. It only needs the
+ * mass and the first moment of the group below each body, accumulated in
+ * one backward pass. */
+int& Dynamic::
+computeComPass( int& dummy,int time )
 {
   sotDEBUGIN(25);
-  newtonEulerSINTERN(time);
+  RigidBodyTree& tree = kinematicTree(time);
+  const unsigned int NBBODIES = tree.size();
+  const unsigned int NBDOF = tree.numberDof();
+
+  for( std::list<ComGroup>::iterator iter = comGroups_.begin();
+       iter != comGroups_.end();
+       ++iter )
+    {
+      ComGroup& group = *iter;
+      if( group.member.size()!=NBBODIES ) updateComGroupMembers( group );
+
+      double mass = 0.;
+      spatial::Vector3 moment;
+      for( unsigned int i=0;i<NBBODIES;++i )
+	{
+	  if( group.member[i] )
+	    {
+	      group.subtreeMass[i] = tree.link(i).mass;
+	      group.subtreeMoment[i] = tree.link(i).mass*tree[i].com;
+	      mass += group.subtreeMass[i];
+	      moment += group.subtreeMoment[i];
+	    }
+	  else
+	    {
+	      group.subtreeMass[i] = 0.;
+	      group.subtreeMoment[i] = spatial::Vector3();
+	    }
+	}
+      for( unsigned int i=NBBODIES;i-->1; )
+	{
+	  const int parent = tree.link(i).parent;
+	  group.subtreeMass[parent] += group.subtreeMass[i];
+	  group.subtreeMoment[parent] += group.subtreeMoment[i];
+	}
+
+      const double inv = ( mass>0. ) ? 1./mass : 0.;
+      if( group.com.size()!=3 ) group.com.resize(3);
+      for( unsigned int r=0;r<3;++r ) group.com(r) = inv*moment[r];
+
+      ml::Matrix& Jcom = group.Jcom;
+      if( (Jcom.nbRows()!=3)||(Jcom.nbCols()!=NBDOF) ) Jcom.resize(3,NBDOF);
+      for( unsigned int i=0;i<NBBODIES;++i )
+	{
+	  const RigidBodyTree::Link& link = tree.link(i);
+	  for( unsigned int k=0;k<link.nbDof;++k )
+	    {
+	      const spatial::Motion& S = tree[i].S[k];
+	      const spatial::Vector3 col
+		= inv*( group.subtreeMass[i]*S.linear
+			+ cross( S.angular,group.subtreeMoment[i] ) );
+	      for( unsigned int r=0;r<3;++r ) Jcom(r,link.rank+k) = col[r];
+	    }
+	}
+    }
 
-  matrixNxP jacobian;
-  jacobian.resize(3, m_HDR->numberDof());
-  m_HDR->getJacobianCenterOfMass(*m_HDR->rootJoint(), jacobian);
+  sotDEBUGOUT(25);
+  return dummy;
+}
 
-  Jcom.initFromMotherLib(jacobian);
+ml::Matrix& Dynamic::
+computeJcom( ml::Matrix& Jcom,int time )
+{
+  sotDEBUGIN(25);
+  comSINTERN(time);
+  Jcom = comGroups_.front().Jcom;
   sotDEBUGOUT(25);
   return Jcom;
 }
@@ -1024,83 +1988,426 @@ ml::Vector& Dynamic::
 computeCom( ml::Vector& com,int time )
 {
   sotDEBUGIN(25);
-  newtonEulerSINTERN(time);
-  com.resize(3);
-  MAAL1_V3d_to_MAAL2(m_HDR->positionCenterOfMass(),com);
+  comSINTERN(time);
+  com = comGroups_.front().com;
   sotDEBUGOUT(25);
   return com;
 }
 
+ml::Vector& Dynamic::
+computeGroupCom( ComGroup* group,ml::Vector& res,int time )
+{
+  sotDEBUGIN(25);
+  comSINTERN(time);
+  res = group->com;
+  sotDEBUGOUT(25);
+  return res;
+}
+
+ml::Matrix& Dynamic::
+computeGroupJcom( ComGroup* group,ml::Matrix& res,int time )
+{
+  sotDEBUGIN(25);
+  comSINTERN(time);
+  res = group->Jcom;
+  sotDEBUGOUT(25);
+  return res;
+}
+
+/* Composite-rigid-body pass: the column of dof k of joint i is the
+ * momentum Ic_i.S_k of the subtree of i moving along S_k, with Ic_i the
+ * sum of the inertias below i, and the moment taken at the center of
+ * mass. */
+ml::Matrix& Dynamic::
+computeAg( ml::Matrix& Ag,int time )
+{
+  sotDEBUGIN(25);
+  comSINTERN(time);
+  const RigidBodyTree& tree = kinematicTree(time);
+  const unsigned int NBBODIES = tree.size();
+  const unsigned int NBDOF = tree.numberDof();
+
+  if( compositeInertia_.size()!=NBBODIES ) compositeInertia_.resize( NBBODIES );
+  for( unsigned int i=0;i<NBBODIES;++i ) compositeInertia_[i] = tree[i].inertia;
+  for( unsigned int i=NBBODIES;i-->1; )
+    compositeInertia_[tree.link(i).parent] += compositeInertia_[i];
+
+  const ml::Vector& com = comGroups_.front().com;
+  const spatial::Vector3 c( com(0),com(1),com(2) );
+  if( (Ag.nbRows()!=6)||(Ag.nbCols()!=NBDOF) ) Ag.resize(6,NBDOF);
+  for( unsigned int i=0;i<NBBODIES;++i )
+    {
+      const RigidBodyTree::Link& link = tree.link(i);
+      for( unsigned int k=0;k<link.nbDof;++k )
+	{
+	  const spatial::Force h = compositeInertia_[i]*tree[i].S[k];
+	  const spatial::Vector3 n = h.momentAt(c);
+	  for( unsigned int r=0;r<3;++r )
+	    {
+	      Ag(r,link.rank+k) = h.linear[r];
+	      Ag(r+3,link.rank+k) = n[r];
+	    }
+	}
+    }
+
+  sotDEBUGOUT(25);
+  return Ag;
+}
+
+/* Rate of change of the momentum at the world origin for a zero joint
+ * acceleration: sum of I_i.c_i + v_i x* I_i.v_i. Moving the moment to the
+ * center of mass only adds c x dh/dt, since the linear momentum is
+ * parallel to the velocity of the center of mass. */
+ml::Vector& Dynamic::
+computeAgDrift( ml::Vector& res,int time )
+{
+  sotDEBUGIN(25);
+  comSINTERN(time);
+  treeVelocitySINTERN(time);
+  const RigidBodyTree& tree = *tree_;
+
+  spatial::Force drift;
+  for( unsigned int i=0;i<tree.size();++i )
+    {
+      const RigidBodyTree::Body& body = tree[i];
+      drift += body.inertia*body.c + cross( body.v,body.inertia*body.v );
+    }
+
+  const ml::Vector& com = comGroups_.front().com;
+  const spatial::Vector3 n = drift.momentAt( spatial::Vector3( com(0),com(1),com(2) ) );
+  if( res.size()!=6 ) res.resize(6);
+  for( unsigned int r=0;r<3;++r )
+    {
+      res(r) = drift.linear[r];
+      res(r+3) = n[r];
+    }
+
+  sotDEBUGOUT(25);
+  return res;
+}
+
+/* Gravity of jrl-dynamics. */
+static const spatial::Vector3 GRAVITY( 0.,0.,-9.81 );
+
+ml::Vector& Dynamic::
+computeGravityTorque( ml::Vector& res,int time )
+{
+  sotDEBUGIN(25);
+  kinematicTree(time).gravityTorques( GRAVITY,res );
+  sotDEBUGOUT(25);
+  return res;
+}
+
+ml::Vector& Dynamic::
+computeNonlinearEffects( ml::Vector& res,int time )
+{
+  sotDEBUGIN(25);
+  treeVelocitySINTERN(time);
+  tree_->biasTorques( GRAVITY,res );
+  sotDEBUGOUT(25);
+  return res;
+}
+
+ml::Vector& Dynamic::
+computeForwardDynamics( ml::Vector& res,int time )
+{
+  sotDEBUGIN(25);
+  treeVelocitySINTERN(time);
+  const ml::Vector& torque = jointTorqueSIN(time);
+  const unsigned int nbDof = tree_->numberDof();
+  if( torqueBuffer_.size()!=nbDof ) torqueBuffer_.resize( nbDof );
+  if( torque.size()==nbDof )
+    { for( unsigned int i=0;i<nbDof;++i ) torqueBuffer_(i) = torque(i); }
+  else if( (nbDof>=6)&&(torque.size()==nbDof-6) )
+    {
+      for( unsigned int i=0;i<6;++i ) torqueBuffer_(i) = 0.;
+      for( unsigned int i=0;i<torque.size();++i ) torqueBuffer_(i+6) = torque(i);
+    }
+  else
+    {
+      SOT_THROW ExceptionDynamic( ExceptionDynamic::JOINT_SIZE,
+				  getName() +
+				  ": torque vector size incorrect",
+				  " (Vector size is %d, should be %d or %d).",
+				  torque.size(),nbDof,nbDof-6 );
+    }
+
+  if(! tree_->forwardDynamics( GRAVITY,torqueBuffer_,res ) )
+    {
+      SOT_THROW ExceptionDynamic( ExceptionDynamic::GENERIC,
+				  getName() +
+				  ": singular articulated inertia, a joint "
+				  "moves a massless subtree." );
+    }
+  sotDEBUGOUT(25);
+  return res;
+}
+
+/* Compare two vectors, exactly if tol is zero. */
+static bool sameValues( const ml::Vector& a,const ml::Vector& b,const double tol )
+{
+  if( a.size()!=b.size() ) return false;
+  for( unsigned int i=0;i<a.size();++i )
+    if( std::fabs( a(i)-b(i) )>tol ) return false;
+  return true;
+}
+
+MatrixInertia& Dynamic::
+inertiaAlgorithm( int time )
+{
+  kinematicsSINTERN(time);
+  /* The static data are read from the poses and the jacobians of m_HDR,
+   * at the configuration staged above. */
+  if(! crbaReady_ )
+    {
+      crba_.init( m_HDR );
+      crbaReady_ = true;
+    }
+  crba_.update();
+  return crba_;
+}
+
+const ml::Matrix& Dynamic::
+inertiaMatrix( int time )
+{
+  sotDEBUGIN(25);
+  kinematicsSINTERN(time);
+
+  if( inertiaMemoValid_ && sameValues( positionBuffer_,inertiaKey_,inertiaTolerance_ ) )
+    {
+      ++inertiaMemoHits_;
+      sotDEBUGOUT(25);
+      return inertiaMemo_;
+    }
+  ++inertiaMemoMisses_;
+
+  MatrixInertia& crba = inertiaAlgorithm(time);
+  ml::Matrix& A = inertiaMemo_;
+  const unsigned int n = crba.getDimension();
+  if( (A.nbRows()!=n)||(A.nbCols()!=n) ) A.resize( n,n );
+  crba.computeInertiaMatrix( A.accessToMotherLib().data().begin(),
+			     MatrixInertia::DENSE );
+
+  /* Legacy debugInertia mode: locked dofs are decoupled from the others
+   * with an identity block. */
+  if( (0!=debugInertia)&&(dofMask_.size()==A.nbRows()) )
+    {
+      for( unsigned int i=0;i<dofMask_.size();++i )
+	{
+	  if( 0!=dofMask_(i) ) continue;
+	  for( unsigned int j=0;j<A.nbCols();++j )
+	    { A(i,j)=A(j,i)=0; }
+	  A(i,i)=1;
+	}
+    }
+
+  inertiaKey_ = positionBuffer_;
+  inertiaMemoValid_ = true;
+  ++inertiaMemoVersion_;
+
+  sotDEBUGOUT(25);
+  return A;
+}
+
 ml::Matrix& Dynamic::
 computeInertia( ml::Matrix& A,int time )
 {
   sotDEBUGIN(25);
-  newtonEulerSINTERN(time);
+  /* The signal alternates between two buffers: the memo is copied even
+   * when it has not been recomputed. */
+  A = inertiaMatrix(time);
+  sotDEBUGOUT(25);
+  return A;
+}
 
-  m_HDR->computeInertiaMatrix();
-  A.initFromMotherLib(m_HDR->inertiaMatrix());
-
-  if( 1==debugInertia )
-    {
-      for( unsigned int i=0;i<18;++i )
-	for( unsigned int j=0;j<36;++j )
-	  if( i==j ) A(i,i)=1;
-	  else {  A(i,j)=A(j,i)=0; }
-      for( unsigned int i=20;i<22;++i )
-	for( unsigned int j=0;j<36;++j )
-	  if( i==j ) A(i,i)=1;
-	  else {  A(i,j)=A(j,i)=0; }
-      for( unsigned int i=28;i<36;++i )
-	for( unsigned int j=0;j<36;++j )
-	  if( i==j ) A(i,i)=1;
-	  else {  A(i,j)=A(j,i)=0; }
-    }
-  else if( 2==debugInertia )
-    {
-      for( unsigned int i=0;i<18;++i )
-	for( unsigned int j=0;j<36;++j )
-	  if( i==j ) A(i,i)=1;
-	  else {  A(i,j)=A(j,i)=0; }
-      for( unsigned int i=20;i<22;++i )
-	for( unsigned int j=0;j<36;++j )
-	  if( i==j ) A(i,i)=1;
-	  else {  A(i,j)=A(j,i)=0; }
-      for( unsigned int i=28;i<29;++i )
-	for( unsigned int j=0;j<36;++j )
-	  if( i==j ) A(i,i)=1;
-	  else {  A(i,j)=A(j,i)=0; }
-      for( unsigned int i=35;i<36;++i )
-	for( unsigned int j=0;j<36;++j )
-	  if( i==j ) A(i,i)=1;
-	  else {  A(i,j)=A(j,i)=0; }
+ml::Matrix& Dynamic::
+computeInertiaPacked( ml::Matrix& A,int time )
+{
+  sotDEBUGIN(25);
+  if( MatrixInertia::DENSE==inertiaLayout_ )
+    {
+      A = inertiaMatrix(time);
+      sotDEBUGOUT(25);
+      return A;
     }
 
+  /* The packed layouts are written straight from the algorithm, without
+   * the dense memo, but for the masked matrix of debugInertia. */
+  const bool masked = ( 0!=debugInertia );
+  MatrixInertia& crba = inertiaAlgorithm(time);
+  const unsigned int n = crba.getDimension();
+  if( MatrixInertia::PACKED_UPPER==inertiaLayout_ )
+    {
+      const unsigned int size = MatrixInertia::bufferSize( n,inertiaLayout_ );
+      if( (A.nbRows()!=size)||(A.nbCols()!=1) ) A.resize( size,1 );
+    }
+  else
+    {
+      /* ml::Matrix is row-major: the lower triangle column-major is
+       * stored as the upper triangle row-major. The other entries are
+       * not written by the algorithm, and the buffer may have held
+       * another layout. */
+      if( (A.nbRows()!=n)||(A.nbCols()!=n) ) A.resize( n,n );
+      for( unsigned int i=1;i<n;++i )
+	for( unsigned int j=0;j<i;++j ) A(i,j) = 0.;
+    }
+  double* buffer = A.accessToMotherLib().data().begin();
+  if( masked )
+    MatrixInertia::pack( inertiaMatrix(time),inertiaLayout_,buffer );
+  else
+    crba.computeInertiaMatrix( buffer,inertiaLayout_ );
   sotDEBUGOUT(25);
   return A;
 }
 
+InertiaFactorization& Dynamic::
+computeInertiaFactorization( InertiaFactorization& res,int time )
+{
+  sotDEBUGIN(25);
+  const ml::Matrix& A = inertiaMatrix(time);
+  const RigidBodyTree& tree = kinematicTree(time);
+
+  /* Dofs in the order of the tree, parents first. The parent of the
+   * first dof of a joint is the last dof of its nearest actuated
+   * ancestor. */
+  factorizationParents_.clear();
+  factorizationOrder_.clear();
+  std::vector<int>& lastDof = factorizationLastDof_;
+  lastDof.assign( tree.size(),-1 );
+  for( unsigned int i=0;i<tree.size();++i )
+    {
+      const RigidBodyTree::Link& link = tree.link(i);
+      int parentDof = ( link.parent<0 ) ? -1 : lastDof[link.parent];
+      for( unsigned int k=0;k<link.nbDof;++k )
+	{
+	  factorizationParents_.push_back( parentDof );
+	  factorizationOrder_.push_back( link.rank+k );
+	  parentDof = factorizationOrder_.size()-1;
+	}
+      lastDof[i] = parentDof;
+    }
+  if( (A.nbRows()!=factorizationOrder_.size())||(A.nbCols()!=A.nbRows()) )
+    {
+      SOT_THROW ExceptionDynamic( ExceptionDynamic::JOINT_SIZE,
+				  getName() +
+				  ": inertia matrix size incorrect",
+				  " (Matrix size is %d, should be %d).",
+				  A.nbRows(),factorizationOrder_.size() );
+    }
+
+  res.setStructure( factorizationParents_,factorizationOrder_ );
+  if(! res.factorize( A ) )
+    {
+      SOT_THROW ExceptionDynamic( ExceptionDynamic::GENERIC,
+				  getName() +
+				  ": the inertia matrix is not positive definite." );
+    }
+  sotDEBUGOUT(25);
+  return res;
+}
+
 ml::Matrix& Dynamic::
 computeInertiaReal( ml::Matrix& res,int time )
 {
   sotDEBUGIN(25);
 
-  const ml::Matrix & A = inertiaSOUT(time);
+  const ml::Matrix & A = inertiaMatrix(time);
   const ml::Vector & gearRatio = gearRatioSOUT(time);
   const ml::Vector & inertiaRotor = inertiaRotorSOUT(time);
 
-  res = A;
-  for( unsigned int i=0;i<gearRatio.size();++i )
-    res(i,i) += (gearRatio(i)*gearRatio(i)*inertiaRotor(i));
+  if( (inertiaRealVersion_!=inertiaMemoVersion_)
+      ||(! sameValues( gearRatio,inertiaRealGearRatio_,0. ))
+      ||(! sameValues( inertiaRotor,inertiaRealRotor_,0. )) )
+    {
+      inertiaRealMemo_ = A;
+      for( unsigned int i=0;i<gearRatio.size();++i )
+	inertiaRealMemo_(i,i) += (gearRatio(i)*gearRatio(i)*inertiaRotor(i));
+      inertiaRealGearRatio_ = gearRatio;
+      inertiaRealRotor_ = inertiaRotor;
+      inertiaRealVersion_ = inertiaMemoVersion_;
+    }
+  res = inertiaRealMemo_;
+
+  sotDEBUGOUT(25);
+  return res;
+}
+
+/* The mask is either empty (all dofs active) or of the size of the
+ * configuration. */
+static void checkMaskSize( const ml::Vector& mask,const unsigned int size )
+{
+  if( (mask.size()!=0)&&(mask.size()!=size) )
+    {
+      SOT_THROW ExceptionDynamic( ExceptionDynamic::JOINT_SIZE,
+				  "Active dof mask of wrong size",
+				  " (%d instead of %d).",mask.size(),size );
+    }
+}
+
+ml::Matrix& Dynamic::
+selectActiveColumns( const ml::Matrix& J,ml::Matrix& res ) const
+{
+  checkMaskSize( dofMask_,J.nbCols() );
+  if( dofMask_.size()==0 ) { res = J; return res; }
+  const unsigned int NBACTIVE = activeDofs_.size();
+  if( (res.nbRows()!=J.nbRows())||(res.nbCols()!=NBACTIVE) )
+    res.resize( J.nbRows(),NBACTIVE );
+  for( unsigned int i=0;i<J.nbRows();++i )
+    for( unsigned int k=0;k<NBACTIVE;++k )
+      res(i,k) = J(i,activeDofs_[k]);
+  return res;
+}
 
+ml::Matrix& Dynamic::
+computeInertiaReduced( ml::Matrix& res,int time )
+{
+  sotDEBUGIN(25);
+  const ml::Matrix& A = inertiaMatrix(time);
+  checkMaskSize( dofMask_,A.nbCols() );
+  if( dofMask_.size()==0 ) { res = A; return res; }
+  const unsigned int NBACTIVE = activeDofs_.size();
+  if( (res.nbRows()!=NBACTIVE)||(res.nbCols()!=NBACTIVE) )
+    res.resize( NBACTIVE,NBACTIVE );
+  for( unsigned int i=0;i<NBACTIVE;++i )
+    for( unsigned int j=0;j<NBACTIVE;++j )
+      res(i,j) = A(activeDofs_[i],activeDofs_[j]);
   sotDEBUGOUT(25);
   return res;
 }
 
+ml::Matrix& Dynamic::
+computeJcomReduced( ml::Matrix& res,int time )
+{
+  return selectActiveColumns( JcomSOUT(time),res );
+}
+
+ml::Vector& Dynamic::
+computeTorqueDriftReduced( ml::Vector& res,int time )
+{
+  sotDEBUGIN(25);
+  const ml::Vector& drift = dynamicDriftSOUT(time);
+  checkMaskSize( dofMask_,drift.size() );
+  if( dofMask_.size()==0 ) { res = drift; return res; }
+  const unsigned int NBACTIVE = activeDofs_.size();
+  if( res.size()!=NBACTIVE ) res.resize( NBACTIVE );
+  for( unsigned int k=0;k<NBACTIVE;++k )
+    res(k) = drift(activeDofs_[k]);
+  sotDEBUGOUT(25);
+  return res;
+}
+
+ml::Matrix& Dynamic::
+computeReducedJacobian( dg::SignalTimeDependent<ml::Matrix,int>* J,
+			ml::Matrix& res,int time )
+{
+  return selectActiveColumns( (*J)(time),res );
+}
+
 double& Dynamic::
 computeFootHeight (double&, int time)
 {
   sotDEBUGIN(25);
-  newtonEulerSINTERN(time);
+  kinematicsSINTERN(time);
   CjrlFoot* RightFoot = m_HDR->rightFoot();
   vector3d AnkleInLocalRefFrame;
   RightFoot->getAnklePositionInLocalFrame(AnkleInLocalRefFrame);
@@ -1129,6 +2436,22 @@ jacobiansSOUT( const std::string& name )
 				  name.c_str());
   }
 }
+dg::SignalTimeDependent<SparseJacobian,int>& Dynamic::
+sparseJacobiansSOUT( const std::string& name )
+{
+  SignalBase<int> & sigabs = Entity::getSignal(name);
+
+  try {
+    dg::SignalTimeDependent<SparseJacobian,int>& res
+      = dynamic_cast< dg::SignalTimeDependent<SparseJacobian,int>& >( sigabs );
+    return res;
+  } catch( std::bad_cast e ) {
+    SOT_THROW ExceptionSignal( ExceptionSignal::BAD_CAST,
+				  "Impossible cast.",
+				  " (while getting signal <%s> of type sparse jacobian.",
+				  name.c_str());
+  }
+}
 dg::SignalTimeDependent<MatrixHomogeneous,int>& Dynamic::
 positionsSOUT( const std::string& name )
 {
@@ -1180,180 +2503,293 @@ accelerationsSOUT( const std::string& name )
 }
 
 
-int& Dynamic::
-computeNewtonEuler( int& dummy,int time )
+/* Copy the input vector into the persistent buffer, resizing the buffer
+ * only when the dimension changes. */
+static void stageInput( const ml::Vector& input,ml::Vector& buffer )
+{
+  if( buffer.size()!=input.size() ) buffer.resize( input.size() );
+  const vectorN& in = input.accessToMotherLib();
+  vectorN& out = buffer.accessToMotherLib();
+  std::copy( in.begin(),in.end(),out.begin() );
+}
+
+/* Overwrite the 6 first coordinates of the buffer by the free-flyer input. */
+static void stageFreeFlyer( const ml::Vector& ffinput,ml::Vector& buffer )
+{
+  for( unsigned int i=0;i<6;++i ) buffer(i) = ffinput(i);
+}
+
+void Dynamic::
+stageState( int time,KinematicsOrder order )
 {
   sotDEBUGIN(15);
-  ml::Vector pos = jointPositionSIN(time); // TODO &pos
-  ml::Vector vel = jointVelocitySIN(time);
-  ml::Vector acc = jointAccelerationSIN(time);
-
-  sotDEBUG(5) << "computeNewtonEuler: " << pos << endl;
-  firstSINTERN(time);
+  stageInput( jointPositionSIN(time),positionBuffer_ );
   if( freeFlyerPositionSIN )
     {
-      const ml::Vector& ffpos = freeFlyerPositionSIN(time);
-
-      for( int i=0;i<6;++i ) pos(i) = ffpos(i) ;
-      sotDEBUG(5) << "computeNewtonEuler: (" << name << ") ffpos = " << ffpos << endl;
-   }
-  sotDEBUG(5) << "computeNewtonEuler: (" << name << ") pos = " << pos << endl;
-  if( freeFlyerVelocitySIN )
-    {
-      const ml::Vector& ffvel = freeFlyerVelocitySIN(time);
-      for( int i=0;i<6;++i ) vel(i) = ffvel(i);
-    }
-  if( freeFlyerAccelerationSIN )
-    {
-      const ml::Vector& ffacc = freeFlyerAccelerationSIN(time);
-      for( int i=0;i<6;++i ) acc(i) = ffacc(i);
+      stageFreeFlyer( freeFlyerPositionSIN(time),positionBuffer_ );
+      sotDEBUG(5) << "stageState: (" << name << ") ffpos = "
+		  << freeFlyerPositionSIN(time) << endl;
     }
-  if(! m_HDR->currentConfiguration(pos.accessToMotherLib()))
+  sotDEBUG(5) << "stageState: (" << name << ") pos = "
+	      << positionBuffer_ << endl;
+  if(! m_HDR->currentConfiguration(positionBuffer_.accessToMotherLib()))
     {
       SOT_THROW ExceptionDynamic( ExceptionDynamic::JOINT_SIZE,
 				  getName() +
 				  ": position vector size incorrect",
 				  " (Vector size is %d, should be %d).",
-				  pos.size(),
+				  positionBuffer_.size(),
 				  m_HDR->currentConfiguration().size() );
     }
+  if( order<VELOCITY_ORDER ) { sotDEBUGOUT(15); return; }
 
-
-  if(! m_HDR->currentVelocity(vel.accessToMotherLib()) )
+  stageInput( jointVelocitySIN(time),velocityBuffer_ );
+  if( freeFlyerVelocitySIN )
+    stageFreeFlyer( freeFlyerVelocitySIN(time),velocityBuffer_ );
+  if(! m_HDR->currentVelocity(velocityBuffer_.accessToMotherLib()) )
     {
       SOT_THROW ExceptionDynamic( ExceptionDynamic::JOINT_SIZE,
 				  getName() +
 				  ": velocity vector size incorrect",
 				  " (Vector size is %d, should be %d).",
-				  vel.size(),
+				  velocityBuffer_.size(),
 				  m_HDR->currentVelocity().size() );
     }
+  if( order<ACCELERATION_ORDER ) { sotDEBUGOUT(15); return; }
 
-  if(! m_HDR->currentAcceleration(acc.accessToMotherLib()) )
+  stageInput( jointAccelerationSIN(time),accelerationBuffer_ );
+  if( freeFlyerAccelerationSIN )
+    stageFreeFlyer( freeFlyerAccelerationSIN(time),accelerationBuffer_ );
+  if(! m_HDR->currentAcceleration(accelerationBuffer_.accessToMotherLib()) )
     {
       SOT_THROW ExceptionDynamic( ExceptionDynamic::JOINT_SIZE,
 				  getName() +
 				  ": acceleration vector size incorrect",
 				  " (Vector size is %d, should be %d).",
-				  acc.size(),
+				  accelerationBuffer_.size(),
 				  m_HDR->currentAcceleration().size() );
     }
+  sotDEBUGOUT(15);
+}
 
-  m_HDR->computeForwardKinematics();
+void Dynamic::
+runForwardKinematics( KinematicsOrder order )
+{
+  sotDEBUGIN(15);
+  /* Switch off the computations that the stage does not need, and restore
+   * the user settings afterwards. */
+  for( unsigned int i=0;i<NB_STAGE_PROPERTIES;++i )
+    {
+      stagePropertySaved_[i] = false;
+      if( STAGE_PROPERTY_ORDERS[i]<=order ) continue;
+      if(! m_HDR->getProperty( stagePropertyNames_[i],stagePropertyValues_[i] ))
+	continue;
+      stagePropertySaved_[i] = true;
+      m_HDR->setProperty( stagePropertyNames_[i],stagePropertyOff_ );
+    }
 
-  sotDEBUG(1)<< "pos = " <<pos <<endl;
-  sotDEBUG(1)<< "vel = " <<vel <<endl;
-  sotDEBUG(1)<< "acc = " <<acc <<endl;
+  computeRobotKinematics();
 
+  for( unsigned int i=0;i<NB_STAGE_PROPERTIES;++i )
+    if( stagePropertySaved_[i] )
+      m_HDR->setProperty( stagePropertyNames_[i],stagePropertyValues_[i] );
   sotDEBUGOUT(15);
-  return dummy;
 }
-int& Dynamic::
-initNewtonEuler( int& dummy,int time )
+
+void Dynamic::
+computeRobotKinematics( void )
 {
-  sotDEBUGIN(15);
-  firstSINTERN.setReady(false);
-  computeNewtonEuler(dummy,time);
-  for( int i=0;i<3;++i )
-    m_HDR->computeForwardKinematics();
+  m_HDR->computeForwardKinematics();
+}
 
-  sotDEBUGOUT(15);
-  return dummy;
+void Dynamic::
+computeJointJacobian( CjrlJoint* aJoint )
+{
+  aJoint->computeJacobianJointWrtConfig();
 }
 
-ml::Vector& Dynamic::
-getUpperJointLimits(ml::Vector& res, const int&)
+/* True if the buffer already holds the input, with the free-flyer
+ * override applied. */
+static bool isStaged( const ml::Vector& input,const ml::Vector* ffinput,
+		      const ml::Vector& buffer )
 {
-  sotDEBUGIN(15);
-  const unsigned int NBJ = m_HDR->numberDof();
-  res.resize( NBJ );
-  for( unsigned int i=0;i<NBJ;++i )
+  if( buffer.size()!=input.size() ) return false;
+  const vectorN& in = input.accessToMotherLib();
+  const vectorN& staged = buffer.accessToMotherLib();
+  unsigned int start = 0;
+  if( 0!=ffinput )
     {
-      res(i)=m_HDR->upperBoundDof( i );
+      for( unsigned int i=0;i<6;++i )
+	if( staged(i)!=(*ffinput)(i) ) return false;
+      start = 6;
     }
-  sotDEBUG(15) << "upperLimit (" << NBJ << ")=" << res <<endl;
-  sotDEBUGOUT(15);
-  return res;
+  for( unsigned int i=start;i<in.size();++i )
+    if( staged(i)!=in(i) ) return false;
+  return true;
 }
 
-ml::Vector& Dynamic::
-getLowerJointLimits(ml::Vector& res, const int&)
+bool Dynamic::
+isStageCurrent( KinematicsOrder order,int time )
 {
-  sotDEBUGIN(15);
-  const unsigned int NBJ = m_HDR->numberDof();
-  res.resize( NBJ );
-  for( unsigned int i=0;i<NBJ;++i )
-    {
-      res(i)=m_HDR->lowerBoundDof( i );
-    }
-  sotDEBUG(15) << "lowerLimit (" << NBJ << ")=" << res <<endl;
-  sotDEBUGOUT(15);
-  return res;
+  if( (stageTime_!=time)||(stageOrder_<order) ) return false;
+  if(! isStaged( jointPositionSIN(time),
+		 freeFlyerPositionSIN ? &freeFlyerPositionSIN(time) : 0,
+		 positionBuffer_ ) )
+    return false;
+  if( order<VELOCITY_ORDER ) return true;
+  if(! isStaged( jointVelocitySIN(time),
+		 freeFlyerVelocitySIN ? &freeFlyerVelocitySIN(time) : 0,
+		 velocityBuffer_ ) )
+    return false;
+  if( order<ACCELERATION_ORDER ) return true;
+  return isStaged( jointAccelerationSIN(time),
+		   freeFlyerAccelerationSIN ? &freeFlyerAccelerationSIN(time) : 0,
+		   accelerationBuffer_ );
 }
 
-ml::Vector& Dynamic::
-getUpperVelocityLimits(ml::Vector& res, const int&)
+Dynamic::KinematicsOrder Dynamic::
+pluggedOrder( void ) const
+{
+  if(! jointVelocitySIN.isPlugged() ) return POSITION_ORDER;
+  if(! jointAccelerationSIN.isPlugged() ) return VELOCITY_ORDER;
+  return ACCELERATION_ORDER;
+}
+
+void Dynamic::
+computeStage( KinematicsOrder order,int time )
 {
   sotDEBUGIN(15);
-  const unsigned int NBJ = m_HDR->numberDof();
-  res.resize( NBJ );
-  for( unsigned int i=0;i<NBJ;++i )
+  /* A geometric read only runs the geometric pass, which leaves the
+   * momentum and the ZMP of m_HDR untouched; a dynamic read at the same
+   * time then runs the higher pass. The momentum is differentiated by
+   * m_HDR from one pass to the next: a first-order read runs the highest
+   * pass allowed by the plugged inputs, so that the momentum is computed
+   * once per time. */
+  if( order>=VELOCITY_ORDER )
     {
-      res(i)=m_HDR->upperVelocityBoundDof( i );
+      const KinematicsOrder plugged = pluggedOrder();
+      if( order<plugged ) order = plugged;
     }
-  sotDEBUG(15) << "upperVelocityLimit (" << NBJ << ")=" << res <<endl;
+
+  /* The stage is reused only if the inputs did not change since: an input
+   * can be modified and the graph recomputed at the same time. */
+  if( isStageCurrent(order,time) ) { sotDEBUGOUT(15); return; }
+  /* Adding the higher orders to a geometric pass leaves the poses, and
+   * thus the per-joint cache, unchanged. */
+  const bool samePositions = isStageCurrent(POSITION_ORDER,time);
+
+  firstSINTERN(time);
+  stageState(time,order);
+  runForwardKinematics(order);
+  stageTime_ = time;
+  stageOrder_ = order;
+  if(! samePositions ) ++stageCount_;
+
+  sotDEBUG(1)<< "pos = " <<positionBuffer_ <<endl;
   sotDEBUGOUT(15);
-  return res;
 }
 
-ml::Vector& Dynamic::
-getLowerVelocityLimits(ml::Vector& res, const int&)
+int& Dynamic::
+computeKinematics( int& dummy,int time )
+{
+  computeStage(POSITION_ORDER,time);
+  return dummy;
+}
+
+int& Dynamic::
+computeVelocityKinematics( int& dummy,int time )
+{
+  computeStage(VELOCITY_ORDER,time);
+  return dummy;
+}
+
+int& Dynamic::
+computeTreeVelocity( int& dummy,int time )
+{
+  velocityKinematicsSINTERN(time);
+  kinematicTree(time).updateVelocities( velocityBuffer_ );
+  return dummy;
+}
+
+int& Dynamic::
+computeNewtonEuler( int& dummy,int time )
+{
+  computeStage(ACCELERATION_ORDER,time);
+  return dummy;
+}
+
+int& Dynamic::
+initNewtonEuler( int& dummy,int time )
 {
   sotDEBUGIN(15);
-  const unsigned int NBJ = m_HDR->numberDof();
-  res.resize( NBJ );
-  for( unsigned int i=0;i<NBJ;++i )
-    {
-      res(i)=m_HDR->lowerVelocityBoundDof( i );
-    }
-  sotDEBUG(15) << "lowerVelocityLimit (" << NBJ << ")=" << res <<endl;
+  firstSINTERN.setReady(false);
+
+  /* Initialize with the inputs available: a kinematic-only graph does not
+   * plug the velocity and acceleration inputs. */
+  const KinematicsOrder order = pluggedOrder();
+  stageState(time,order);
+  for( int i=0;i<3;++i )
+    runForwardKinematics(order);
+
   sotDEBUGOUT(15);
-  return res;
+  return dummy;
 }
 
-
-ml::Vector& Dynamic::
-getUpperTorqueLimits(ml::Vector& res, const int&)
+ml::Matrix& Dynamic::
+computeLimits(ml::Matrix& res, const int&)
 {
   sotDEBUGIN(15);
   const unsigned int NBJ = m_HDR->numberDof();
-  res.resize( NBJ );
+  if( (res.nbRows()!=NB_LIMIT_ROWS)||(res.nbCols()!=NBJ) )
+    res.resize( NB_LIMIT_ROWS,NBJ );
   for( unsigned int i=0;i<NBJ;++i )
     {
-      res(i)=m_HDR->upperTorqueBoundDof( i );
+      res(LOWER_POSITION_LIMIT,i)=m_HDR->lowerBoundDof( i );
+      res(UPPER_POSITION_LIMIT,i)=m_HDR->upperBoundDof( i );
+      res(LOWER_VELOCITY_LIMIT,i)=m_HDR->lowerVelocityBoundDof( i );
+      res(UPPER_VELOCITY_LIMIT,i)=m_HDR->upperVelocityBoundDof( i );
+      res(LOWER_TORQUE_LIMIT,i)=m_HDR->lowerTorqueBoundDof( i );
+      res(UPPER_TORQUE_LIMIT,i)=m_HDR->upperTorqueBoundDof( i );
     }
-  sotDEBUG(15) << "upperTorqueLimit (" << NBJ << ")=" << res <<endl;
+  sotDEBUG(15) << "limits (" << NBJ << ")=" << res <<endl;
   sotDEBUGOUT(15);
   return res;
 }
 
 ml::Vector& Dynamic::
-getLowerTorqueLimits(ml::Vector& res, const int&)
+getLimitRow(const LimitRow row, ml::Vector& res, const int& time)
 {
-  sotDEBUGIN(15);
-  const unsigned int NBJ = m_HDR->numberDof();
-  res.resize( NBJ );
+  const ml::Matrix& limits = limitsSOUT(time);
+  const unsigned int NBJ = limits.nbCols();
+  if( res.size()!=NBJ ) res.resize( NBJ );
   for( unsigned int i=0;i<NBJ;++i )
-    {
-      res(i)=m_HDR->lowerTorqueBoundDof( i );
-    }
-  sotDEBUG(15) << "lowerTorqueLimit (" << NBJ << ")=" << res <<endl;
-  sotDEBUGOUT(15);
+    res(i)=limits( row,i );
   return res;
 }
 
+ml::Vector& Dynamic::
+getUpperJointLimits(ml::Vector& res, const int& time)
+{ return getLimitRow( UPPER_POSITION_LIMIT,res,time ); }
+
+ml::Vector& Dynamic::
+getLowerJointLimits(ml::Vector& res, const int& time)
+{ return getLimitRow( LOWER_POSITION_LIMIT,res,time ); }
+
+ml::Vector& Dynamic::
+getUpperVelocityLimits(ml::Vector& res, const int& time)
+{ return getLimitRow( UPPER_VELOCITY_LIMIT,res,time ); }
+
+ml::Vector& Dynamic::
+getLowerVelocityLimits(ml::Vector& res, const int& time)
+{ return getLimitRow( LOWER_VELOCITY_LIMIT,res,time ); }
 
+ml::Vector& Dynamic::
+getUpperTorqueLimits(ml::Vector& res, const int& time)
+{ return getLimitRow( UPPER_TORQUE_LIMIT,res,time ); }
 
+ml::Vector& Dynamic::
+getLowerTorqueLimits(ml::Vector& res, const int& time)
+{ return getLimitRow( LOWER_TORQUE_LIMIT,res,time ); }
 
 ml::Vector& Dynamic::
 computeTorqueDrift( ml::Vector& tauDrift,const int  & iter )
@@ -1374,52 +2810,75 @@ computeTorqueDrift( ml::Vector& tauDrift,const int  & iter )
 /* --- COMMANDS ------------------------------------------------------------- */
 /* --- COMMANDS ------------------------------------------------------------- */
 
-CjrlJoint* Dynamic::getJointByName( const std::string& jointName )
+void Dynamic::buildJointRegistry( void )
 {
-  if (jointName ==  "gaze") {
-    return m_HDR->gazeJoint();
-  } else if (jointName == "left-ankle") {
-    return m_HDR->leftAnkle();
-  } else if (jointName == "right-ankle") {
-    return m_HDR->rightAnkle();
-  } else if (jointName == "left-wrist") {
-    return m_HDR->leftWrist();
-  } else if (jointName == "right-wrist") {
-    return m_HDR->rightWrist();
-  } else if (jointName == "waist") {
-    return m_HDR->waist();
-  } else if (jointName == "chest") {
-    return m_HDR->chest();
-  } else if (jointName == "gaze") {
-    return m_HDR->gazeJoint();
-  } 
-  
-  // left toe
-  else if (jointName == "left-toe") 
-  {
-    if (m_HDR->leftAnkle()->countChildJoints () == 0)
-    	throw ExceptionDynamic(ExceptionDynamic::GENERIC," The robot has no toes");
-    else
-		return m_HDR->leftAnkle()->childJoint(0);
-  } 
-
-  // right toe
-  else if (jointName == "right-toe") {
-    if (m_HDR->rightAnkle()->countChildJoints () == 0)
-    	throw ExceptionDynamic(ExceptionDynamic::GENERIC," The robot has no toes");
-    else
-		return m_HDR->rightAnkle()->childJoint(0);
+  jointTable_.clear();
+  jointIndex_.clear();
 
-  }
-  else {
-    std::vector< CjrlJoint* > jv = m_HDR->jointVector ();
-    for (std::vector< CjrlJoint* >::const_iterator it = jv.begin();
-	 it != jv.end(); it++) {
-      if ((*it)->getName () == jointName) {
-	return *it;
-      }
+  std::vector< CjrlJoint* > jv = m_HDR->jointVector ();
+  boost::unordered_map<CjrlJoint*,unsigned int> indexOfJoint;
+  jointTable_.resize( jv.size() );
+  for( unsigned int i=0;i<jv.size();++i )
+    {
+      JointInfo& info = jointTable_[i];
+      info.joint = jv[i];
+      info.rank = jv[i]->rankInConfiguration();
+      info.nbDof = jv[i]->numberDof();
+      indexOfJoint[jv[i]] = i;
+      /* The first joint of a given name wins, as with a linear search. */
+      jointIndex_.insert( std::make_pair( jv[i]->getName(),i ) );
     }
-  }
+  for( unsigned int i=0;i<jv.size();++i )
+    {
+      boost::unordered_map<CjrlJoint*,unsigned int>::const_iterator it
+	= indexOfJoint.find( jv[i]->parentJoint() );
+      jointTable_[i].parent = ( it==indexOfJoint.end() ) ? -1 : int(it->second);
+    }
+
+  /* Special names take precedence over joint names. */
+  std::vector< std::pair<std::string,CjrlJoint*> > specials;
+  specials.push_back( std::make_pair( "gaze",m_HDR->gazeJoint() ) );
+  specials.push_back( std::make_pair( "left-ankle",m_HDR->leftAnkle() ) );
+  specials.push_back( std::make_pair( "right-ankle",m_HDR->rightAnkle() ) );
+  specials.push_back( std::make_pair( "left-wrist",m_HDR->leftWrist() ) );
+  specials.push_back( std::make_pair( "right-wrist",m_HDR->rightWrist() ) );
+  specials.push_back( std::make_pair( "waist",m_HDR->waist() ) );
+  specials.push_back( std::make_pair( "chest",m_HDR->chest() ) );
+  if( m_HDR->leftAnkle() && m_HDR->leftAnkle()->countChildJoints()>0 )
+    specials.push_back( std::make_pair( "left-toe",m_HDR->leftAnkle()->childJoint(0) ) );
+  if( m_HDR->rightAnkle() && m_HDR->rightAnkle()->countChildJoints()>0 )
+    specials.push_back( std::make_pair( "right-toe",m_HDR->rightAnkle()->childJoint(0) ) );
+  for( unsigned int i=0;i<specials.size();++i )
+    {
+      boost::unordered_map<CjrlJoint*,unsigned int>::const_iterator it
+	= indexOfJoint.find( specials[i].second );
+      if( it!=indexOfJoint.end() ) jointIndex_[specials[i].first] = it->second;
+    }
+
+  jointRegistryReady_ = true;
+}
+
+void Dynamic::invalidateJointRegistry( void )
+{
+  jointRegistryReady_ = false;
+  invalidateLimits();
+  invalidateModel();
+  jointTable_.clear();
+  jointIndex_.clear();
+  /* The supports and frame corrections belong to the previous tree. */
+  jointCache_.clear();
+}
+
+CjrlJoint* Dynamic::getJointByName( const std::string& jointName )
+{
+  if(! jointRegistryReady_ ) buildJointRegistry();
+
+  boost::unordered_map<std::string,unsigned int>::const_iterator it
+    = jointIndex_.find( jointName );
+  if( it!=jointIndex_.end() ) return jointTable_[it->second].joint;
+
+  if( (jointName == "left-toe")||(jointName == "right-toe") )
+    throw ExceptionDynamic(ExceptionDynamic::GENERIC," The robot has no toes");
   throw ExceptionDynamic(ExceptionDynamic::GENERIC,
 			 jointName + " is not a valid name."
 			 " Valid names are \n"
@@ -1427,12 +2886,58 @@ CjrlJoint* Dynamic::getJointByName( const std::string& jointName )
 			 " right-wrist, waist, chest, or any joint name.");
 }
 
+ml::Matrix Dynamic::getJointTable()
+{
+  if(! jointRegistryReady_ ) buildJointRegistry();
+  ml::Matrix res; res.resize( jointTable_.size(),3 );
+  for( unsigned int i=0;i<jointTable_.size();++i )
+    {
+      res(i,0) = jointTable_[i].rank;
+      res(i,1) = jointTable_[i].nbDof;
+      res(i,2) = jointTable_[i].parent;
+    }
+  return res;
+}
+
+std::string Dynamic::getJointNames()
+{
+  if(! jointRegistryReady_ ) buildJointRegistry();
+  std::string res;
+  for( unsigned int i=0;i<jointTable_.size();++i )
+    {
+      if( i>0 ) res += " ";
+      res += jointTable_[i].joint->getName();
+    }
+  return res;
+}
+
 void Dynamic::cmd_createOpPointSignals( const std::string& opPointName,
 				 const std::string& jointName )
 {
   CjrlJoint* joint = getJointByName(jointName);
   createEndeffJacobianSignal(std::string("J")+opPointName, joint);
   createPositionSignal(opPointName, joint);
+  if (opPointDrift_)
+    createJacobianDriftSignal(std::string("dJv")+opPointName, joint);
+}
+void Dynamic::cmd_createOpPointsSignals( const std::string& opPoints )
+{
+  std::istringstream iss( opPoints );
+  std::vector<std::string> names;
+  std::vector<CjrlJoint*> joints;
+  std::string opPointName,jointName;
+  while( iss >> opPointName )
+    {
+      if(! (iss >> jointName) )
+	{
+	  SOT_THROW ExceptionDynamic( ExceptionDynamic::GENERIC,
+				      "Operational point without joint",
+				      " (op point <%s>).",opPointName.c_str() );
+	}
+      names.push_back( opPointName );
+      joints.push_back( getJointByName(jointName) );
+    }
+  createOpPointSignals( names,joints );
 }
 void Dynamic::cmd_createJacobianWorldSignal( const std::string& signalName,
 				 const std::string& jointName )
@@ -1446,6 +2951,26 @@ void Dynamic::cmd_createJacobianEndEffectorSignal( const std::string& signalName
   CjrlJoint* joint = getJointByName(jointName);
   createEndeffJacobianSignal(signalName, joint);
 }
+void Dynamic::cmd_createSparseJacobianSignal( const std::string& signalName,
+					       const std::string& jointName )
+{
+  CjrlJoint* joint = getJointByName(jointName);
+  createSparseJacobianSignal(signalName, joint);
+}
+void Dynamic::cmd_createReducedJacobianSignal( const std::string& signalName,
+						const std::string& jacobianName )
+{
+  createReducedJacobianSignal(signalName, jacobianName);
+}
+void Dynamic::cmd_createSubtreeComSignals( const std::string& signalName,
+					   const std::string& rootNames )
+{
+  std::istringstream iss( rootNames );
+  std::vector<CjrlJoint*> roots;
+  std::string jointName;
+  while( iss >> jointName ) roots.push_back( getJointByName(jointName) );
+  createSubtreeComSignals(signalName, roots);
+}
 void Dynamic::cmd_createPositionSignal( const std::string& signalName,
 					const std::string& jointName )
 {
@@ -1468,12 +2993,32 @@ commandLine( const std::string& cmdLine,
       cmdArgs>>ws; if(cmdArgs.good())
 		     {
 		       std::string arg; cmdArgs >> arg;
+		       /* Locked ranges of the 36-dof HRP-2 model. */
+		       unsigned int mode1[] = { 0,18, 20,22, 28,36 };
+		       unsigned int mode2[] = { 0,18, 20,22, 28,29, 35,36 };
+		       const unsigned int* ranges = 0; unsigned int nbRanges = 0;
+		       /* The mask of the user is put back when the mode is
+			* switched off. */
+		       const bool wasDebug = ( 0!=debugInertia );
+		       if(! wasDebug ) userDofMask_ = dofMask_;
 		       if( (arg=="true")||(arg=="1") )
-			 { debugInertia = 1; }
+			 { debugInertia = 1; ranges = mode1; nbRanges = 3; }
 		       else if( (arg=="2")||(arg=="grip") )
-			 { debugInertia = 2; }
+			 { debugInertia = 2; ranges = mode2; nbRanges = 4; }
 		       else debugInertia=0;
-
+		       if( 0!=ranges )
+			 {
+			   const unsigned int NBDOF = m_HDR->numberDof();
+			   ml::Vector mask(NBDOF);
+			   for( unsigned int i=0;i<NBDOF;++i ) mask(i) = 1;
+			   for( unsigned int r=0;r<nbRanges;++r )
+			     for( unsigned int i=ranges[2*r];
+				  (i<ranges[2*r+1])&&(i<NBDOF);++i )
+			       mask(i) = 0;
+			   setActiveDofs( mask );
+			 }
+		       else if( wasDebug ) setActiveDofs( userDofMask_ );
+		       invalidateInertiaCache();
 		     }
       else { os << "debugInertia = " << debugInertia << std::endl; }
     }
@@ -1529,6 +3074,16 @@ commandLine( const std::string& cmdLine,
       std::string Jname; cmdArgs >> Jname;
       destroyJacobianSignal(Jname);
     }
+  else if( cmdLine == "destroySparseJacobian" )
+    {
+      std::string Jname; cmdArgs >> Jname;
+      destroySparseJacobianSignal(Jname);
+    }
+  else if( cmdLine == "destroySubtreeCom" )
+    {
+      std::string Jname; cmdArgs >> Jname;
+      destroySubtreeComSignals(Jname);
+    }
   else if( cmdLine == "createPosition" )
     {
       std::string Jname; cmdArgs >> Jname;
@@ -1581,6 +3136,8 @@ commandLine( const std::string& cmdLine,
       std::string Jname; cmdArgs >> Jname;
       destroyJacobianSignal(string("J")+Jname);
       destroyPositionSignal(Jname);
+      if( genericSignalIndex_.count( "dJv"+Jname )>0 )
+	destroyJacobianDriftSignal(string("dJv")+Jname);
     }
   else if( cmdLine == "ndof" ) { os << m_HDR->numberDof() <<endl; return; }
   else if( cmdLine == "setComputeCom" )
@@ -1630,6 +3187,8 @@ commandLine( const std::string& cmdLine,
 	 << "  - createEndeffJacobian <name> <point>:create a signal named <name> "
 	 << "forwarding the jacoian computed at <point>." <<endl
 	 << "  - destroyJacobian <name>\t:delete the jacobian signal <name>" << endl
+	 << "  - destroySparseJacobian <name>\t:delete the sparse jacobian signal <name>" << endl
+	 << "  - destroySubtreeCom <name>\t:delete the subtree com signals <name> and J<name>" << endl
 	 << "  - {create|destroy}Position\t:handle position signals." <<endl
 	 << "  - {create|destroy}OpPoint\t:handle Operation Point (ie pos+jac) signals." <<endl
 	 << "  - {create|destroy}Acceleration\t:handle acceleration signals." <<endl
@@ -1650,6 +3209,7 @@ void Dynamic::createRobot()
   if (m_HDR)
     delete m_HDR;
   m_HDR = factory_.createHumanoidDynamicRobot();
+  invalidateJointRegistry();
 }
 
 void Dynamic::createJoint(const std::string& inJointName,
@@ -1692,6 +3252,7 @@ void Dynamic::setRootJoint(const std::string& inJointName)
 			       " has been created.");
   }
   m_HDR->rootJoint(*jointMap_[inJointName]);
+  invalidateJointRegistry();
 }
 
 void Dynamic::addJoint(const std::string& inParentName,
@@ -1712,6 +3273,7 @@ void Dynamic::addJoint(const std::string& inParentName,
 			       " has been created.");
   }
   jointMap_[inParentName]->addChildJoint(*(jointMap_[inChildName]));
+  invalidateJointRegistry();
 }
 
 void Dynamic::setDofBounds(const std::string& inJointName,
@@ -1729,6 +3291,7 @@ void Dynamic::setDofBounds(const std::string& inJointName,
   }
   jointMap_[inJointName]->lowerBound(inDofId, inMinValue);
   jointMap_[inJointName]->upperBound(inDofId, inMaxValue);
+  invalidateLimits();
 }
 
 void Dynamic::setMass(const std::string& inJointName, double inMass)
@@ -1748,6 +3311,7 @@ void Dynamic::setMass(const std::string& inJointName, double inMass)
   }
   CjrlBody& body = *(joint->linkedBody());
   body.mass(inMass);
+  invalidateBodyInertias();
 }
 
 void Dynamic::setLocalCenterOfMass(const std::string& inJointName,
@@ -1768,6 +3332,7 @@ void Dynamic::setLocalCenterOfMass(const std::string& inJointName,
   }
   CjrlBody& body = *(joint->linkedBody());
   body.localCenterOfMass(maalToVector3d(inCom));
+  invalidateBodyInertias();
 }
 
 void Dynamic::setInertiaMatrix(const std::string& inJointName,
@@ -1788,6 +3353,7 @@ void Dynamic::setInertiaMatrix(const std::string& inJointName,
   }
   CjrlBody& body = *(joint->linkedBody());
   body.inertiaMatrix(maalToMatrix3d(inMatrix));
+  invalidateBodyInertias();
 }
 
 void Dynamic::setSpecificJoint(const std::string& inJointName,
@@ -1936,6 +3502,154 @@ ml::Vector Dynamic::getAnklePositionInFootFrame() const
   return res;
 }
 
+void Dynamic::setActiveDofs( const ml::Vector& mask )
+{
+  dofMask_ = mask;
+  activeDofs_.clear();
+  for( unsigned int i=0;i<mask.size();++i )
+    if( 0!=mask(i) ) activeDofs_.push_back(i);
+  invalidateInertiaCache();
+  inertiaReducedSOUT.setReady();
+  JcomReducedSOUT.setReady();
+  dynamicDriftReducedSOUT.setReady();
+}
+
+ml::Vector Dynamic::getActiveDofs() const
+{
+  return dofMask_;
+}
+
+void Dynamic::setInertiaTolerance( const double& tolerance )
+{
+  inertiaTolerance_ = tolerance;
+  invalidateInertiaCache();
+}
+
+double Dynamic::getInertiaTolerance() const
+{
+  return inertiaTolerance_;
+}
+
+void Dynamic::setInertiaLayout( const std::string& layout )
+{
+  if( layout=="dense" ) inertiaLayout_ = MatrixInertia::DENSE;
+  else if( layout=="packedUpper" ) inertiaLayout_ = MatrixInertia::PACKED_UPPER;
+  else if( layout=="lowerColumnMajor" ) inertiaLayout_ = MatrixInertia::LOWER_COLUMN_MAJOR;
+  else
+    {
+      SOT_THROW ExceptionDynamic( ExceptionDynamic::GENERIC,
+				  getName() + ": unknown inertia layout " + layout +
+				  " (should be dense, packedUpper or lowerColumnMajor)." );
+    }
+  inertiaPackedSOUT.setReady();
+}
+
+std::string Dynamic::getInertiaLayout() const
+{
+  switch( inertiaLayout_ )
+    {
+    case MatrixInertia::PACKED_UPPER: return "packedUpper";
+    case MatrixInertia::LOWER_COLUMN_MAJOR: return "lowerColumnMajor";
+    default: return "dense";
+    }
+}
+
+ml::Vector Dynamic::getInertiaCacheStatistics() const
+{
+  ml::Vector res(2);
+  res(0) = inertiaMemoHits_;
+  res(1) = inertiaMemoMisses_;
+  return res;
+}
+
+void Dynamic::resetInertiaCacheStatistics()
+{
+  inertiaMemoHits_ = 0;
+  inertiaMemoMisses_ = 0;
+}
+
+/* The bound outputs do not depend on the time: they only recompute when
+ * marked as not ready. All of them are marked, since the first one
+ * evaluated would otherwise clear the flag of limitsSOUT for the others. */
+void Dynamic::invalidateLimits()
+{
+  limitsSOUT.setReady();
+  upperJlSOUT.setReady();
+  lowerJlSOUT.setReady();
+  upperVlSOUT.setReady();
+  lowerVlSOUT.setReady();
+  upperTlSOUT.setReady();
+  lowerTlSOUT.setReady();
+}
+
+void Dynamic::invalidateInertiaCache()
+{
+  inertiaMemoValid_ = false;
+  ++inertiaMemoVersion_;
+}
+
+void Dynamic::invalidateModel()
+{
+  invalidateInertiaCache();
+  tree_->invalidate();
+  crbaReady_ = false;
+  modelKey_.clear();
+}
+
+void Dynamic::invalidateBodyInertias()
+{
+  invalidateInertiaCache();
+  tree_->invalidate();
+  crba_.invalidateBodyInertias();
+  modelKey_.clear();
+}
+
+ml::Vector Dynamic::getJacobianCacheStatistics() const
+{
+  ml::Vector res(2);
+  res(0) = 0; res(1) = 0;
+  for( std::map<CjrlJoint*,JointCache>::const_iterator it = jointCache_.begin();
+       it!=jointCache_.end();++it )
+    {
+      res(0) += it->second.jacobianHits;
+      res(1) += it->second.jacobianMisses;
+    }
+  return res;
+}
+
+void Dynamic::resetJacobianCacheStatistics()
+{
+  for( std::map<CjrlJoint*,JointCache>::iterator it = jointCache_.begin();
+       it!=jointCache_.end();++it )
+    {
+      it->second.jacobianHits = 0;
+      it->second.jacobianMisses = 0;
+    }
+}
+
+void Dynamic::setParallelSignals( const unsigned int& nbThreads )
+{
+  delete workerPool_;
+  workerPool_ = 0;
+  if( nbThreads>0 ) workerPool_ = new SignalWorkerPool( nbThreads );
+  prefetchStage_ = 0;
+}
+
+unsigned int Dynamic::getParallelSignals() const
+{
+  return ( 0!=workerPool_ ) ? workerPool_->size() : 0;
+}
+
+void Dynamic::setOpPointDrift( const bool& drift )
+{
+  opPointDrift_ = drift;
+}
+
+bool Dynamic::getOpPointDrift() const
+{
+  return opPointDrift_;
+}
+
 void Dynamic::setGazeParameters(const ml::Vector& inGazeOrigin,
 				const ml::Vector& inGazeDirection)
 {
@@ -1947,6 +3661,127 @@ void Dynamic::setGazeParameters(const ml::Vector& inGazeOrigin,
 	      maalToVector3d(inGazeOrigin));
 }
 
+void Dynamic::setModelCacheDirectory(const std::string& directory)
+{
+  modelCacheDirectory_ = directory;
+}
+
+std::string Dynamic::getModelCacheDirectory() const
+{
+  return modelCacheDirectory_;
+}
+
+bool Dynamic::replayModelDescription(const ModelDescription& model)
+{
+  if (!m_HDR || model.joints.empty()) {
+    return false;
+  }
+  std::vector<CjrlJoint*> joints(model.joints.size());
+  for (unsigned int i=0; i<model.joints.size(); i++) {
+    const ModelDescription::Joint& description = model.joints[i];
+    matrix4d position;
+    for (unsigned int r=0; r<4; r++) {
+      for (unsigned int c=0; c<4; c++) {
+	position(r,c) = description.position[4*r+c];
+      }
+    }
+    CjrlJoint* joint = NULL;
+    switch (description.type) {
+    case ModelDescription::FREEFLYER_JOINT:
+      joint = factory_.createJointFreeflyer(position); break;
+    case ModelDescription::ROTATION_JOINT:
+      joint = factory_.createJointRotation(position); break;
+    case ModelDescription::TRANSLATION_JOINT:
+      joint = factory_.createJointTranslation(position); break;
+    default:
+      joint = factory_.createJointAnchor(position); break;
+    }
+    joint->setName(description.name);
+    if (description.parent < 0) {
+      m_HDR->rootJoint(*joint);
+    } else {
+      joints[description.parent]->addChildJoint(*joint);
+    }
+    for (unsigned int k=0; k<description.nbDof; k++) {
+      const double* bound = &description.bounds[6*k];
+      joint->lowerBound(k, bound[0]);
+      joint->upperBound(k, bound[1]);
+      joint->lowerVelocityBound(k, bound[2]);
+      joint->upperVelocityBound(k, bound[3]);
+      joint->lowerTorqueBound(k, bound[4]);
+      joint->upperTorqueBound(k, bound[5]);
+    }
+    if (description.hasBody) {
+      CjrlBody* body = factory_.createBody();
+      body->mass(description.mass);
+      body->localCenterOfMass(arrayToVector3d(description.com));
+      matrix3d inertia;
+      for (unsigned int r=0; r<3; r++) {
+	for (unsigned int c=0; c<3; c++) {
+	  inertia(r,c) = description.inertia[3*r+c];
+	}
+      }
+      body->inertiaMatrix(inertia);
+      joint->setLinkedBody(*body);
+    }
+    joints[i] = joint;
+  }
+
+  const int* special = model.specialJoints;
+  if (special[ModelDescription::WAIST] >= 0)
+    m_HDR->waist(joints[special[ModelDescription::WAIST]]);
+  if (special[ModelDescription::CHEST] >= 0)
+    m_HDR->chest(joints[special[ModelDescription::CHEST]]);
+  if (special[ModelDescription::GAZE] >= 0)
+    m_HDR->gazeJoint(joints[special[ModelDescription::GAZE]]);
+  for (unsigned int side=0; side<2; side++) {
+    const int wrist = special[side ? ModelDescription::RIGHT_WRIST
+			      : ModelDescription::LEFT_WRIST];
+    if (wrist >= 0) {
+      CjrlJoint* joint = joints[wrist];
+      if (side) m_HDR->rightWrist(joint); else m_HDR->leftWrist(joint);
+      const ModelDescription::Hand& description = model.hands[side];
+      if (description.present) {
+	CjrlHand* hand = factory_.createHand(joint);
+	hand->setCenter(arrayToVector3d(description.center));
+	hand->setThumbAxis(arrayToVector3d(description.thumbAxis));
+	hand->setForeFingerAxis(arrayToVector3d(description.forefingerAxis));
+	hand->setPalmNormal(arrayToVector3d(description.palmNormal));
+	if (side) m_HDR->rightHand(hand); else m_HDR->leftHand(hand);
+      }
+    }
+    const int ankle = special[side ? ModelDescription::RIGHT_ANKLE
+			      : ModelDescription::LEFT_ANKLE];
+    if (ankle >= 0) {
+      CjrlJoint* joint = joints[ankle];
+      if (side) m_HDR->rightAnkle(joint); else m_HDR->leftAnkle(joint);
+      const ModelDescription::Foot& description = model.feet[side];
+      if (description.present) {
+	CjrlFoot* foot = factory_.createFoot(joint);
+	foot->setSoleSize(description.soleLength, description.soleWidth);
+	foot->setAnklePositionInLocalFrame
+	  (arrayToVector3d(description.anklePosition));
+	if (side) m_HDR->rightFoot(foot); else m_HDR->leftFoot(foot);
+      }
+    }
+  }
+  m_HDR->gaze(arrayToVector3d(model.gazeDirection),
+	      arrayToVector3d(model.gazeOrigin));
+  m_HDR->initialize();
+
+  // The ranks of the rank file are not part of the construction
+  // commands: reject the cache if jrl numbers the dofs otherwise.
+  if (m_HDR->numberDof() != model.nbDof) {
+    return false;
+  }
+  for (unsigned int i=0; i<joints.size(); i++) {
+    if (joints[i]->rankInConfiguration() != model.joints[i].rank) {
+      return false;
+    }
+  }
+  return true;
+}
+
 std::ostream& sot::operator<<(std::ostream& os,
 			      const CjrlHumanoidDynamicRobot&)
 {
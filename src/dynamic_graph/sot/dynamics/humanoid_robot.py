@@ -236,8 +236,8 @@ class AbstractHumanoidRobot (object):
 
 
     def initializeOpPoints(self, model):
-        for op in self.OperationalPoints:
-            model.createOpPoint(op, op)
+        model.createOpPoints(' '.join(
+                ['{0} {0}'.format(op) for op in self.OperationalPoints]))
 
     def createFrame(self, frameName, transformation, operationalPoint):
         frame = OpPointModifier(frameName)
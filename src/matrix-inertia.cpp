@@ -21,38 +21,18 @@
 #include <fstream>
 #include <vector>
 #include <map>
+#include <cmath>
+#include <algorithm>
 
 #include <sot-dynamic/matrix-inertia.h>
-#include <jrl/dynamics/Joint.h>
-#include <jrl/dynamics/HumanoidDynamicMultiBody.h>
-#include <abstract-robot-dynamics/robot-dynamics-object-constructor.hh>
+#include <abstract-robot-dynamics/humanoid-dynamic-robot.hh>
 
 #include <sot/core/debug.hh>
+#include <sot/core/exception-dynamic.hh>
 
-using namespace dynamicsJRLJapan;
 using namespace dynamicgraph::sot;
 using namespace dynamicgraph;
 
-static matrix3d skewSymmetric(const vector3d& v)
-{
-  matrix3d res;
-
-  res(0, 0) = 0.0;
-  res(1, 1) = 0.0;
-  res(2, 2) = 0.0;
-
-  res(0, 1) = -v[2];
-  res(0, 2) = v[1];
-
-  res(1, 0) = v[2];
-  res(1, 2) = -v[0];
-
-  res(2, 0) = -v[1];
-  res(2, 1) = v[0];
-
-  return res;
-}
-
 /* -------------------------------------------------------------------------- */
 /* -------------------------------------------------------------------------- */
 /* -------------------------------------------------------------------------- */
@@ -61,7 +41,8 @@ static matrix3d skewSymmetric(const vector3d& v)
 MatrixInertia::
 MatrixInertia( CjrlHumanoidDynamicRobot* aHDR )
   :aHDR_( aHDR )
-  ,aHDMB_( 0x0 )
+  ,bodyInertiasValid_( false )
+  ,dimension_( 0 )
 {
   sotDEBUGIN(25);
   if( aHDR!=NULL ) init( aHDR );
@@ -73,25 +54,33 @@ init( CjrlHumanoidDynamicRobot* aHDR )
 {
   sotDEBUGIN(25);
   aHDR_ = aHDR;
-  aHDMB_ = dynamic_cast<dynamicsJRLJapan::HumanoidDynamicMultiBody*>(aHDR_);
 
-  /* STEP 2: get the joints and resize internal vectors according to
-   * number of joints. */
-  joints_ = aHDMB_->jointVector();
+  /* STEP 2: get the joints, breadth-first so that the parents come
+   * first, and resize internal vectors according to number of joints. */
+  joints_.clear();
+  if( 0!=aHDR_->rootJoint() ) joints_.push_back( aHDR_->rootJoint() );
+  for( size_t i=0;i<joints_.size();++i )
+    for( unsigned int k=0;k<joints_[i]->countChildJoints();++k )
+      joints_.push_back( joints_[i]->childJoint(k) );
   sotDEBUG(25) << "Joints:" << joints_.size() << endl;
 
   parentIndex_.resize(joints_.size());
-  inertia_.resize(joints_.size() + 5, joints_.size() + 5);
-  phi.resize( joints_.size() );
-  iVpi.resize( joints_.size() );
-  iVpiT.resize( joints_.size() );
+  jointModels_.resize( joints_.size() );
+  iXpi.resize( joints_.size() );
   Ic.resize( joints_.size() );
+  bodyInertia_.resize( joints_.size() );
 
   /* STEP 3: create the index of parents. */
   initParents();
 
-  /* STEP 4: initialize phi (dof table) for each joint. */
+  /* STEP 4: choose the kernel of each joint and read phi (dof table)
+   * from the jacobians. */
+  initJointModels();
   initDofTable();
+  inertia_.resize( dimension_,dimension_ );
+
+  /* STEP 5: read the inertias of the bodies. */
+  initBodyInertias();
   sotDEBUGOUT(25);
 }
 
@@ -110,36 +99,251 @@ initParents( void )
 	{
 	  parentIndex_[i] = -1;
 	  sotDEBUG(15) << "parent of\t" << i << "\t(" 
-		       << static_cast<Joint*>(joints_[i])->getName() 
+		       << joints_[i]->getName() 
 		       << "):\t" << -1 << std::endl;
 	}
       else
 	{
 	  parentIndex_[i] = m[joints_[i]->parentJoint()];
 	  sotDEBUG(15) << "parent of\t" << i << ":\t(" 
-		       << static_cast<Joint*>(joints_[i])->getName() 
+		       << joints_[i]->getName() 
 		       << "):\t" << m[joints_[i]->parentJoint()]
-		       << "\t(" << static_cast<Joint*>
-	    (joints_[m[joints_[i]->parentJoint()]])->getName() 
+		       << "\t(" << joints_[m[joints_[i]->parentJoint()]]->getName() 
 		       << ")" << std::endl;
 	}
     }
   sotDEBUGOUT(25);
 }
 
+/* Rotation of angle q about the unit axis a (Rodrigues formula). */
+static spatial::Matrix3 axisAngle( const spatial::Vector3& a,const double q )
+{
+  const spatial::Matrix3 K = spatial::skew( a );
+  const spatial::Matrix3 K2 = K*K;
+  const double s = sin( q ),c = 1.-cos( q );
+  spatial::Matrix3 R = spatial::Matrix3::identity();
+  for( unsigned int k=0;k<9;++k ) R.m[k] += s*K.m[k] + c*K2.m[k];
+  return R;
+}
+
+/* Rz(yaw).Ry(pitch).Rx(roll). */
+static spatial::Matrix3 rollPitchYaw( const double roll,const double pitch,
+				      const double yaw )
+{
+  const double cr = cos( roll ),sr = sin( roll );
+  const double cp = cos( pitch ),sp = sin( pitch );
+  const double cy = cos( yaw ),sy = sin( yaw );
+  spatial::Matrix3 R;
+  R(0,0) = cy*cp; R(0,1) = cy*sp*sr-sy*cr; R(0,2) = cy*sp*cr+sy*sr;
+  R(1,0) = sy*cp; R(1,1) = sy*sp*sr+cy*cr; R(1,2) = sy*sp*cr-cy*sr;
+  R(2,0) = -sp;   R(2,1) = cp*sr;          R(2,2) = cp*cr;
+  return R;
+}
+
+static void readTransformation( const matrix4d& m4,spatial::Matrix3& R,
+				spatial::Vector3& p )
+{
+  for( unsigned int i=0;i<3;++i )
+    {
+      for( unsigned int j=0;j<3;++j )
+	R(i,j) = MAL_S4x4_MATRIX_ACCESS_I_J(m4,i,j);
+      p[i] = MAL_S4x4_MATRIX_ACCESS_I_J(m4,i,3);
+    }
+}
+
+/* The rotation of the joint frame in the parent frame is
+ * piRi = R0.M(q), M the motion of the joint, identity at q=0: iXpi has the
+ * rotation iRpi = M(q)'.R0'. joint.rotation holds R0'. TYPE is a constant,
+ * so that each instantiation only keeps its own case. */
+template< int TYPE >
+void MatrixInertia::
+jointTransform( const JointModel& joint,const vectorN& q,
+		spatial::Transform& iXpi )
+{
+  const unsigned int r = joint.rank;
+  switch( TYPE )
+    {
+    case REVOLUTE_JOINT:
+      iXpi = spatial::Transform( axisAngle( joint.axis,-q(r) )*joint.rotation,
+				 joint.translation );
+      break;
+    case PRISMATIC_JOINT:
+      iXpi = spatial::Transform( joint.rotation,
+				 joint.translation
+				 + q(r)*transposeMultiply( joint.rotation,joint.axis ) );
+      break;
+    case SPHERICAL_JOINT:
+      iXpi = spatial::Transform( rollPitchYaw( q(r),q(r+1),q(r+2) ).transpose()
+				 *joint.rotation,
+				 joint.translation );
+      break;
+    case FREEFLYER_JOINT:
+      /* The configuration is expressed in the parent frame:
+       * piRi = rpy(q).R0. */
+      iXpi = spatial::Transform( joint.rotation
+				 *rollPitchYaw( q(r+3),q(r+4),q(r+5) ).transpose(),
+				 joint.translation
+				 + spatial::Vector3( q(r),q(r+1),q(r+2) ) );
+      break;
+    default:
+      iXpi = spatial::Transform( joint.rotation,joint.translation );
+    }
+}
+
+/* The joint frames are the ones of currentTransformation(), in which the
+ * centers of mass and inertias of the bodies are expressed. The static
+ * parts of the joint transforms are read from the current poses, the
+ * motion of each joint at the current configuration removed. */
+void MatrixInertia::
+initJointModels( void )
+{
+  sotDEBUGIN(25);
+  const vectorN& q = aHDR_->currentConfiguration();
+  dimension_ = 0;
+  unsigned int nbColumns = 0;
+  for(size_t i = 0; i < joints_.size(); ++i)
+    {
+      CjrlJoint* j = joints_[i];
+      JointModel & model = jointModels_[i];
+      model.rank = j->rankInConfiguration();
+      model.nbDof = j->numberDof();
+      model.firstColumn = nbColumns;
+      model.parentAxes = ( parentIndex_[i]<0 )&&( 6==model.nbDof );
+      nbColumns += model.nbDof;
+      if( model.rank+model.nbDof>dimension_ ) dimension_ = model.rank+model.nbDof;
+
+      /* Pose of the joint frame in the parent frame. */
+      spatial::Matrix3 R,Rp = spatial::Matrix3::identity();
+      spatial::Vector3 p,pp;
+      readTransformation( j->currentTransformation(),R,p );
+      if( parentIndex_[i]>=0 )
+	readTransformation( joints_[parentIndex_[i]]->currentTransformation(),Rp,pp );
+      const spatial::Matrix3 piRi = Rp.transpose()*R;
+      const spatial::Vector3 piPi = transposeMultiply( Rp,p-pp );
+
+      model.axis = spatial::Vector3();
+      switch( model.nbDof )
+	{
+	case 0: model.type = FIXED_JOINT; break;
+	case 3: model.type = SPHERICAL_JOINT; break;
+	case 6: model.type = FREEFLYER_JOINT; break;
+	case 1:
+	  {
+	    /* A prismatic joint does not move the orientation. */
+	    j->computeJacobianJointWrtConfig();
+	    const matrixNxP & J = j->jacobianJointWrtConfig();
+	    const spatial::Vector3 w( J(3,model.rank),J(4,model.rank),J(5,model.rank) );
+	    const spatial::Vector3 v( J(0,model.rank),J(1,model.rank),J(2,model.rank) );
+	    const bool angular = ( 0.!=w[0] )||( 0.!=w[1] )||( 0.!=w[2] );
+	    model.type = angular ? REVOLUTE_JOINT : PRISMATIC_JOINT;
+	    model.axis = transposeMultiply( R,angular ? w : v );
+	    break;
+	  }
+	default:
+	  SOT_THROW ExceptionDynamic( ExceptionDynamic::GENERIC,
+				      "Joint " + j->getName() +
+				      " has an unsupported number of dofs." );
+	}
+
+      const unsigned int r = model.rank;
+      spatial::Matrix3 R0 = piRi;
+      model.translation = piPi;
+      switch( model.type )
+	{
+	case REVOLUTE_JOINT:
+	  R0 = piRi*axisAngle( model.axis,-q(r) );
+	  break;
+	case PRISMATIC_JOINT:
+	  model.translation = piPi - q(r)*( piRi*model.axis );
+	  break;
+	case SPHERICAL_JOINT:
+	  R0 = piRi*rollPitchYaw( q(r),q(r+1),q(r+2) ).transpose();
+	  break;
+	case FREEFLYER_JOINT:
+	  R0 = rollPitchYaw( q(r+3),q(r+4),q(r+5) ).transpose()*piRi;
+	  model.translation = piPi - spatial::Vector3( q(r),q(r+1),q(r+2) );
+	  break;
+	default: break;
+	}
+      model.rotation = R0.transpose();
+
+      switch( model.type )
+	{
+	case FIXED_JOINT: model.transform = &jointTransform<FIXED_JOINT>; break;
+	case REVOLUTE_JOINT: model.transform = &jointTransform<REVOLUTE_JOINT>; break;
+	case PRISMATIC_JOINT: model.transform = &jointTransform<PRISMATIC_JOINT>; break;
+	case SPHERICAL_JOINT: model.transform = &jointTransform<SPHERICAL_JOINT>; break;
+	case FREEFLYER_JOINT: model.transform = &jointTransform<FREEFLYER_JOINT>; break;
+	}
+      sotDEBUG(25) << "Joint " << i << ": type = " << model.type
+		   << ", rank = " << model.rank <<endl;
+    }
+  phi.resize( nbColumns );
+  parentPhi.resize( nbColumns );
+  sotDEBUGOUT(25);
+}
+
+/* The motion subspaces are the own columns of the jrl jacobians, so that
+ * the parameterization of the velocity is the one of jrl-dynamics. They
+ * are constant in the joint frame, except for a free-flyer root whose
+ * columns are constant in the world frame: those are kept in parentPhi
+ * and expressed in the joint frame by update(). */
 void MatrixInertia::
 initDofTable( void )
 {
   sotDEBUGIN(25);
   for(size_t i = 0; i < joints_.size(); ++i)
     {
-      Joint* j = static_cast<Joint*>(joints_[i]);
-      vector3d z =  j->axe();
-      ml::Vector & phi_i = phi[i];
-      phi_i.resize(6);      phi_i.fill(0.);
-      for( int n=0;n<3;++n ) phi_i(n+3) = z(n);
-      sotDEBUG(25) << phi_i <<endl;
+      const JointModel & model = jointModels_[i];
+      if( 0==model.nbDof ) continue;
+      CjrlJoint* j = joints_[i];
+      j->computeJacobianJointWrtConfig();
+      const matrixNxP & J = j->jacobianJointWrtConfig();
+      spatial::Matrix3 R; spatial::Vector3 p;
+      readTransformation( j->currentTransformation(),R,p );
+      for( unsigned int k=0;k<model.nbDof;++k )
+	{
+	  const unsigned int col = model.rank+k;
+	  const spatial::Motion axis
+	    ( spatial::Vector3( J(3,col),J(4,col),J(5,col) ),
+	      spatial::Vector3( J(0,col),J(1,col),J(2,col) ) );
+	  spatial::Motion& phik = phi[model.firstColumn+k];
+	  phik = spatial::Motion( transposeMultiply( R,axis.angular ),
+				  transposeMultiply( R,axis.linear ) );
+	  if( model.parentAxes ) parentPhi[model.firstColumn+k] = axis;
+	}
+    }
+  sotDEBUGOUT(25);
+}
+
+void MatrixInertia::
+initBodyInertias( void )
+{
+  sotDEBUGIN(25);
+  for( size_t i = 0;i<joints_.size();++i )
+    {
+      const CjrlBody* body = joints_[i]->linkedBody();
+      if( body==0x0 ) { bodyInertia_[i] = spatial::Inertia(); continue; }
+
+      /* Position of the mass in the joint frame. */
+      const vector3d & com = body->localCenterOfMass();
+      /* Inertia of the link. */
+      const matrix3d & Icm = body->inertiaMatrix();
+      sotDEBUG(45) << "com"<<i<<" = [ " << com <<"]"<<endl;
+      sotDEBUG(45) << "Icm"<<i<<" = [ " << Icm<<"]"<<endl;
+      spatial::Matrix3 I;
+      for( unsigned int loopi=0;loopi<3;++loopi )
+	for( unsigned int loopj=0;loopj<3;++loopj )
+	  I( loopi,loopj ) = Icm( loopi,loopj );
+
+      /* Inertia 6D matrix of the body in the joint frame.
+       *   I = [  Icm+mSc.Sc'   mSc   ]
+       *       [     mSc'      mId   ]
+       */
+      bodyInertia_[i] = spatial::Inertia::fromBody
+	( body->mass(),spatial::Vector3( com[0],com[1],com[2] ),I );
     }
+  bodyInertiasValid_ = true;
   sotDEBUGOUT(25);
 }
 
@@ -152,158 +356,125 @@ MatrixInertia::~MatrixInertia()
 void MatrixInertia::update( void )
 {
   sotDEBUGIN(25);
-  const vectorN  & currentConf = aHDMB_->currentConfiguration();
+  const vectorN  & currentConf = aHDR_->currentConfiguration();
   sotDEBUG(45) << "q = [ " << currentConf << endl;
 
-  sotDEBUG(15) << "Spatial transforms:" << std::endl;
   const size_t SIZE = joints_.size();
   for(size_t i = 0; i < SIZE; ++i)
     {
-      sotDEBUG(25) << "Joint " << i << ": rank = " 
-		   << joints_[i]->rankInConfiguration() <<endl;
-      Joint* j = static_cast<Joint*>(joints_[i]);
-
-      /* iRpi: Rotation from joint i to parent of i. */
-      MatrixRotation piRi; 
-      {
-	/* phi_[1] = phi_(1:3) is the rotation axis of the joint. */
-	matrix3d Ri; j->getStaticRotation(Ri);
-	vector3d axeJ = Ri*j->axe();
-	const double & q = currentConf(joints_[i]->rankInConfiguration());
-	sotDEBUG(45) << "q"<<i<<" = " <<q <<endl;
-	matrix3d piRi_tmp;
-	j->RodriguesRotation(axeJ,q,piRi_tmp);
-	for( unsigned int loopi=0;loopi<3;++loopi )
-	  for( unsigned int loopj=0;loopj<3;++loopj ) 
-	    piRi( loopi,loopj ) = piRi_tmp(loopi,loopj);
-      }
-      ml::Vector piTi(3); 
-      {
-	vector3d piTi_tmp; 
-	j->getStaticTranslation( piTi_tmp );
-	for( unsigned int loopi=0;loopi<3;++loopi ) piTi(loopi) = piTi_tmp(loopi);
-      }
-      /* Twist matrix iXpi: transfo of the velocities between i en pi (parent i). 
-       * iXpi = [   iRpi     Skew( iRpi.t )*iRpi  ]
-       *        [     0        iRpi               ]  */
-      MatrixHomogeneous piMi; piMi.buildFrom( piRi,piTi );
-      MatrixHomogeneous iMpi; piMi.inverse(iMpi);
-      sotDEBUG(45) << "piMi = " <<piMi <<endl;
-      sotDEBUG(45) << "iMpi = " <<iMpi <<endl;
-
-      iVpi[i].buildFrom( iMpi );
-      iVpi[i].transpose( iVpiT[i] );
-      sotDEBUG(25) << "iVpi" << i << " = " <<iVpi[i] <<endl;
+      const JointModel & model = jointModels_[i];
+      model.transform( model,currentConf,iXpi[i] );
+      if(! model.parentAxes ) continue;
+      const spatial::Matrix3& E = iXpi[i].E;
+      for( unsigned int k=0;k<model.nbDof;++k )
+	{
+	  const spatial::Motion& axis = parentPhi[model.firstColumn+k];
+	  phi[model.firstColumn+k] = spatial::Motion( E*axis.angular,E*axis.linear );
+	}
     }
   sotDEBUGOUT(25);
 }
 
-void MatrixInertia::computeInertiaMatrix()
+template< class Output >
+void MatrixInertia::computeInertiaMatrix( Output& output )
 {
-  sotDEBUGIN(25);
-  inertia_.fill(0.0);
-
   const size_t SIZE = joints_.size();
 
-  /* Compute the local 6D inertia matrices. */
-  for( size_t i = 0;i<SIZE;++i )
-    {
-      /* Position of the mass in the joint frame. */
-      vector3d com = joints_[i]->linkedBody()->localCenterOfMass();
-      matrix3d Sc = skewSymmetric(com);
-      /* Inertia of the link. */
-      matrix3d Icm = joints_[i]->linkedBody()->inertiaMatrix();
-      
-      double m = joints_[i]->linkedBody()->mass();
-
-      
-      /* Ic_ is the inertia 6D matrix of the joint in the joint frame. 
-       *   Ic = [  Ai+mSc.Sc'   mSc   ]
-       *        [     mSc'      mId   ]   
-       */
-      sotDEBUG(45) << "com"<<i<<" = [ " << com <<"]"<<endl;
-      sotDEBUG(45) << "Sc"<<i<<" = [ " << Sc<<"]"<<endl;
-      sotDEBUG(45) << "Icm"<<i<<" = [ " << Icm<<"]"<<endl;
-      matrix3d Sct = Sc.Transpose();
-      matrix3d Irr = Sc*Sct;
-      ml::Matrix & Ici = Ic[i];  Ici.resize(6,6);
-      for( unsigned int loopi=0;loopi<3;++loopi )
-	for( unsigned int loopj=0;loopj<3;++loopj )
-	  {
-	    /*TT*/if( loopi==loopj ) Ici( loopi,loopj ) = m; 
-	    else Ici( loopi,loopj ) = 0.;
-	    /*TR*/Ici( loopi,loopj+3 ) = m*Sct( loopi,loopj );
-	    /*RT*/Ici( loopi+3,loopj ) = m*Sc( loopi,loopj );
-	    /*RR*/Ici( loopi+3,loopj+3 ) = m*Irr( loopi,loopj )+ Icm( loopi,loopj );
-	  }
-      
-      sotDEBUG(25) << "Ic" << i << " = " << Ici;
-    }
-  
-  ml::Vector Fi(6);
-  ml::Matrix iVpiT_Ici(6,6);
-  ml::Matrix iVpiT_Ici_iVpi(6,6);
+  /* The composite inertias start from the ones of the bodies. */
+  if(! bodyInertiasValid_ ) initBodyInertias();
+  Ic = bodyInertia_;
 
-  for( int i=SIZE-1;i>=1;--i ) 
+  for( int i=SIZE-1;i>=0;--i )
     {
-      const unsigned int iRank = joints_[i]->rankInConfiguration();
-
-      ml::Matrix & Ici = Ic[i]; 
-      sotMatrixTwist & iVpii = iVpi[i]; 
-      MatrixForce & iVpiiT = iVpiT[i]; 
-      ml::Vector & phii = phi[i];
-      /* F = Ic_i . phi_i */
-      Fi = Ici*phii;  
-      /* H_ii = phi_i' . F */
-      /*DEBUGinertia_(i + 5, i + 5) = phii.scalarProduct(Fi);*/
-   
- 
-      inertia_(iRank,iRank) = phii.scalarProduct(Fi);
-      sotDEBUG(30) << "phi"<<i<<" = " << phii;
-      sotDEBUG(35) << "Fi"<<i<<" =  " << Fi << endl;
-      sotDEBUG(25) << "IcA"<<i<<" = " << Ici << endl;
-      sotDEBUG(45) << "Joint " << i << " in " << iRank <<endl;
-
-      /* Ic_pi = Ic_pi + iXpi' Ic_i iXpi */
-      iVpiiT.multiply(Ici,iVpiT_Ici);
-      iVpiT_Ici.multiply( iVpii,iVpiT_Ici_iVpi );
-
-      sotDEBUG(45) << "Icpi"<<parentIndex_[i]<<" = "  << Ic[parentIndex_[i]]  ;
-      Ic[ parentIndex_[i] ] += iVpiT_Ici_iVpi;
-
-      sotDEBUG(45) << "Icpi"<<parentIndex_[i]<<"_"<<i<<" = "  << Ic[parentIndex_[i]]  ;
-      sotDEBUG(45) << "Vpi"<<i<<" = "  << iVpii ;
+      const JointModel & model = jointModels_[i];
+      const spatial::Inertia & Ici = Ic[i];
+      const spatial::Motion* phii = model.nbDof>0 ? &phi[model.firstColumn] : 0x0;
+      sotDEBUG(45) << "Joint " << i << " in " << model.rank <<endl;
 
-      size_t j = i;
-      while(parentIndex_[j] != 0)
+      for( unsigned int a=0;a<model.nbDof;++a )
 	{
-	  /* F = jXpj' . F */
-	  Fi = iVpiT[j]*Fi;
-	  /* j = pj */
-	  j = parentIndex_[j];
-	  /* Hij = Hji = F' phi_j */
-	  inertia_(iRank,joints_[j]->rankInConfiguration()) 
-	    = inertia_(joints_[j]->rankInConfiguration(),iRank) 
-	    = Fi.scalarProduct( phi[j]);
-	  sotDEBUG(35) << "Fi =  " << Fi << endl;
-	  sotDEBUG(35) << "FiXphi =  " <<  inertia_(j + 5, i + 5) << endl;
-  	}
-
-      /* When parentIndex_[j] == 0: FREE FLYER. */
-      Fi = iVpiT[j]*Fi;
-      for(size_t k = 0; k < 6; ++k)
-	{
-	  inertia_(iRank, k) = inertia_(k,iRank) = Fi(k);
+	  /* F = Ic_i . phi_i */
+	  spatial::Force Fi = Ici*phii[a];
+	  /* H_ii = phi_i' . F */
+	  for( unsigned int b=0;b<=a;++b )
+	    output( model.rank+a,model.rank+b,spatial::dot( phii[b],Fi ) );
+
+	  int j = i;
+	  while( parentIndex_[j]>=0 )
+	    {
+	      /* F = jXpj' . F */
+	      Fi = iXpi[j].applyTranspose( Fi );
+	      /* j = pj */
+	      j = parentIndex_[j];
+	      /* Hij = Hji = F' phi_j */
+	      const JointModel & modelj = jointModels_[j];
+	      for( unsigned int b=0;b<modelj.nbDof;++b )
+		output( model.rank+a,modelj.rank+b,
+			spatial::dot( phi[modelj.firstColumn+b],Fi ) );
+	    }
 	}
+
+      /* Ic_pi = Ic_pi + iXpi' Ic_i iXpi */
+      if( parentIndex_[i]>=0 )
+	Ic[ parentIndex_[i] ] += iXpi[i].applyTranspose( Ici );
+    }
+}
+
+namespace
+{
+  /* Symmetric entries of the inertia matrix written in inertia_. */
+  struct MatrixOutput
+  {
+    ml::Matrix& A;
+    MatrixOutput( ml::Matrix& inA ) : A( inA ) {}
+    void operator()( const size_t i,const size_t j,const double value )
+    { A(i,j) = A(j,i) = value; }
+  };
+
+  /* Entries written in a caller buffer, the layout fixed at compile time
+   * so that the index computation is inlined. */
+  template< int LAYOUT >
+  struct BufferOutput
+  {
+    double* A;
+    size_t n;
+    BufferOutput( double* inA,const size_t inN ) : A( inA ),n( inN ) {}
+    void operator()( const size_t i,const size_t j,const double value )
+    {
+      const MatrixInertia::Layout layout = static_cast<MatrixInertia::Layout>( LAYOUT );
+      A[ MatrixInertia::bufferIndex( i,j,n,layout ) ] = value;
+      if( MatrixInertia::DENSE==layout ) A[ MatrixInertia::bufferIndex( j,i,n,layout ) ] = value;
     }
+  };
+}
 
-  /* --- FREE FLYER = Ic0 --- */
-  const ml::Matrix & Ic0 = Ic[0];
-  for(size_t i = 0; i < 6; ++i)
-    for(size_t j = 0; j < 6; ++j)
-      {inertia_(i, j) = Ic0(i,j);}
+void MatrixInertia::computeInertiaMatrix()
+{
+  sotDEBUGIN(25);
+  inertia_.fill(0.0);
+  MatrixOutput output( inertia_ );
+  computeInertiaMatrix( output );
+  sotDEBUGOUT(25);
+}
 
+void MatrixInertia::computeInertiaMatrix( double* A,const Layout layout )
+{
+  sotDEBUGIN(25);
+  const size_t n = getDimension();
+  /* Zero the entries that computeInertiaMatrix(output) does not pass. */
+  if( LOWER_COLUMN_MAJOR==layout )
+    { for( size_t j=0;j<n;++j ) std::fill( A+j*n+j,A+(j+1)*n,0. ); }
+  else std::fill( A,A+bufferSize( n,layout ),0. );
 
+  switch( layout )
+    {
+    case PACKED_UPPER:
+      {	BufferOutput<PACKED_UPPER> output( A,n ); computeInertiaMatrix( output ); break; }
+    case LOWER_COLUMN_MAJOR:
+      { BufferOutput<LOWER_COLUMN_MAJOR> output( A,n ); computeInertiaMatrix( output ); break; }
+    default:
+      { BufferOutput<DENSE> output( A,n ); computeInertiaMatrix( output ); break; }
+    }
   sotDEBUGOUT(25);
 }
 
@@ -315,9 +486,9 @@ void MatrixInertia::computeInertiaMatrix()
 void MatrixInertia::
 getInertiaMatrix(double* A)
 {
-  for(size_t i = 0; i < (joints_.size() + 5); ++i)
-    for(size_t j = 0; j < (joints_.size() + 5); ++j)
-      A[i * (joints_.size() + 5) + j] = inertia_(i, j);
+  for(size_t i = 0; i < dimension_; ++i)
+    for(size_t j = 0; j < dimension_; ++j)
+      A[i * dimension_ + j] = inertia_(i, j);
 }
 
 const maal::boost::Matrix& MatrixInertia::
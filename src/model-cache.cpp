@@ -0,0 +1,498 @@
+/*
+ * Copyright 2010,
+ * François Bleibel,
+ * Olivier Stasse,
+ *
+ * CNRS/AIST
+ *
+ * This file is part of sot-dynamic.
+ * sot-dynamic is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ * sot-dynamic is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.  You should
+ * have received a copy of the GNU Lesser General Public License along
+ * with sot-dynamic.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "model-cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <map>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <jrl/mal/matrixabstractlayer.hh>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/weak_ptr.hpp>
+
+using namespace dynamicgraph::sot;
+
+/* --------------------------------------------------------------------- */
+/* --- DESCRIPTION ----------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+static void readVector( const vector3d& v,double* out )
+{
+  for( unsigned int i=0;i<3;++i ) out[i] = MAL_S3_VECTOR_ACCESS(v,i);
+}
+
+bool ModelDescription::
+capture( CjrlHumanoidDynamicRobot& robot )
+{
+  if( 0==robot.rootJoint() ) return false;
+
+  /* The joint types are read from the jacobians at the zero
+   * configuration. The configuration of the robot is restored after. */
+  const vectorN previous = robot.currentConfiguration();
+  MAL_VECTOR_DIM(q,double,robot.numberDof());
+  for( unsigned int i=0;i<q.size();++i ) q(i) = 0.;
+  robot.currentConfiguration( q );
+  robot.computeForwardKinematics();
+
+  const bool captured = read( robot );
+
+  robot.currentConfiguration( previous );
+  robot.computeForwardKinematics();
+  return captured;
+}
+
+bool ModelDescription::
+read( CjrlHumanoidDynamicRobot& robot )
+{
+  CjrlJoint* root = robot.rootJoint();
+  nbDof = robot.numberDof();
+
+  /* Breadth-first, so that parents come first. */
+  std::vector<CjrlJoint*> jrlJoints( 1,root );
+  for( unsigned int i=0;i<jrlJoints.size();++i )
+    for( unsigned int k=0;k<jrlJoints[i]->countChildJoints();++k )
+      jrlJoints.push_back( jrlJoints[i]->childJoint(k) );
+
+  joints.resize( jrlJoints.size() );
+  for( unsigned int i=0;i<jrlJoints.size();++i )
+    {
+      CjrlJoint* jrlJoint = jrlJoints[i];
+      Joint& joint = joints[i];
+      joint.name = jrlJoint->getName();
+      joint.parent = -1;
+      for( unsigned int j=0;j<i;++j )
+	if( jrlJoints[j]==jrlJoint->parentJoint() ) joint.parent = j;
+      joint.rank = jrlJoint->rankInConfiguration();
+      joint.nbDof = jrlJoint->numberDof();
+
+      switch( joint.nbDof )
+	{
+	case 0: joint.type = ANCHOR_JOINT; break;
+	case 6: joint.type = FREEFLYER_JOINT; break;
+	case 1:
+	  {
+	    jrlJoint->computeJacobianJointWrtConfig();
+	    const matrixNxP& J = jrlJoint->jacobianJointWrtConfig();
+	    const unsigned int col = joint.rank;
+	    const bool angular = ( 0.!=J(3,col) )||( 0.!=J(4,col) )||( 0.!=J(5,col) );
+	    joint.type = angular ? ROTATION_JOINT : TRANSLATION_JOINT;
+	    break;
+	  }
+	default: return false;
+	}
+
+      const matrix4d& M = jrlJoint->initialPosition();
+      for( unsigned int r=0;r<4;++r )
+	for( unsigned int c=0;c<4;++c )
+	  joint.position[4*r+c] = MAL_S4x4_MATRIX_ACCESS_I_J(M,r,c);
+
+      joint.bounds.resize( 6*joint.nbDof );
+      double* bound = joint.nbDof>0 ? &joint.bounds[0] : 0;
+      for( unsigned int k=0;k<joint.nbDof;++k )
+	{
+	  *bound++ = jrlJoint->lowerBound(k);
+	  *bound++ = jrlJoint->upperBound(k);
+	  *bound++ = jrlJoint->lowerVelocityBound(k);
+	  *bound++ = jrlJoint->upperVelocityBound(k);
+	  *bound++ = jrlJoint->lowerTorqueBound(k);
+	  *bound++ = jrlJoint->upperTorqueBound(k);
+	}
+
+      const CjrlBody* body = jrlJoint->linkedBody();
+      joint.hasBody = ( 0!=body );
+      joint.mass = 0.;
+      std::fill( joint.com,joint.com+3,0. );
+      std::fill( joint.inertia,joint.inertia+9,0. );
+      if( joint.hasBody )
+	{
+	  joint.mass = body->mass();
+	  readVector( body->localCenterOfMass(),joint.com );
+	  const matrix3d& I = body->inertiaMatrix();
+	  for( unsigned int r=0;r<3;++r )
+	    for( unsigned int c=0;c<3;++c )
+	      joint.inertia[3*r+c] = MAL_S3x3_MATRIX_ACCESS_I_J(I,r,c);
+	}
+    }
+
+  CjrlJoint* special[NB_SPECIAL_JOINTS] =
+    { robot.waist(),robot.chest(),robot.leftWrist(),robot.rightWrist(),
+      robot.leftAnkle(),robot.rightAnkle(),robot.gazeJoint() };
+  for( unsigned int s=0;s<NB_SPECIAL_JOINTS;++s )
+    {
+      specialJoints[s] = -1;
+      for( unsigned int i=0;i<jrlJoints.size();++i )
+	if( (0!=special[s])&&(jrlJoints[i]==special[s]) ) specialJoints[s] = i;
+    }
+
+  CjrlHand* jrlHands[2] = { robot.leftHand(),robot.rightHand() };
+  CjrlFoot* jrlFeet[2] = { robot.leftFoot(),robot.rightFoot() };
+  for( unsigned int side=0;side<2;++side )
+    {
+      Hand& hand = hands[side];
+      hand.present = ( 0!=jrlHands[side] );
+      if( hand.present )
+	{
+	  vector3d v;
+	  jrlHands[side]->getCenter(v); readVector( v,hand.center );
+	  jrlHands[side]->getThumbAxis(v); readVector( v,hand.thumbAxis );
+	  jrlHands[side]->getForeFingerAxis(v); readVector( v,hand.forefingerAxis );
+	  jrlHands[side]->getPalmNormal(v); readVector( v,hand.palmNormal );
+	}
+
+      Foot& foot = feet[side];
+      foot.present = ( 0!=jrlFeet[side] );
+      if( foot.present )
+	{
+	  vector3d v;
+	  jrlFeet[side]->getSoleSize( foot.soleLength,foot.soleWidth );
+	  jrlFeet[side]->getAnklePositionInLocalFrame(v);
+	  readVector( v,foot.anklePosition );
+	}
+    }
+
+  readVector( robot.gazeOrigin(),gazeOrigin );
+  readVector( robot.gazeDirection(),gazeDirection );
+  return true;
+}
+
+/* --------------------------------------------------------------------- */
+/* --- SERIALIZATION --------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+/* The data are stored in the native byte order: a file written on a
+ * machine of another endianness is rejected by the header check. */
+
+namespace
+{
+  const char MAGIC[8] = { 'S','O','T','D','Y','N','M','C' };
+  const boost::uint32_t VERSION = 1;
+  const boost::uint32_t ENDIANNESS = 0x01020304;
+
+  const ModelCache::Hash FNV_OFFSET = UINT64_C(14695981039346656037);
+  const ModelCache::Hash FNV_PRIME = UINT64_C(1099511628211);
+
+  ModelCache::Hash fnv( const char* data,size_t size,
+			ModelCache::Hash hash=FNV_OFFSET )
+  {
+    for( size_t i=0;i<size;++i )
+      {
+	hash ^= static_cast<unsigned char>( data[i] );
+	hash *= FNV_PRIME;
+      }
+    return hash;
+  }
+
+  class Writer
+  {
+  public:
+    std::string buffer;
+
+    template< typename T >
+    void put( const T& value )
+    { buffer.append( reinterpret_cast<const char*>(&value),sizeof(T) ); }
+    void put( const double* values,unsigned int n )
+    { buffer.append( reinterpret_cast<const char*>(values),n*sizeof(double) ); }
+    void put( const std::string& s )
+    {
+      put( boost::uint32_t(s.size()) );
+      buffer.append( s );
+    }
+    void put( bool b ) { put( boost::uint8_t(b?1:0) ); }
+  };
+
+  /* Every read is checked against the end of the buffer, so that a
+   * truncated or corrupted file fails cleanly. */
+  class Reader
+  {
+  public:
+    Reader( const char* data,size_t size ) : cur(data),end(data+size) {}
+    const char* cur;
+    const char* end;
+
+    size_t remaining( void ) const { return end-cur; }
+    bool getBytes( void* out,size_t size )
+    {
+      if( remaining()<size ) return false;
+      memcpy( out,cur,size ); cur += size;
+      return true;
+    }
+    template< typename T >
+    bool get( T& value ) { return getBytes( &value,sizeof(T) ); }
+    bool get( double* values,unsigned int n ) { return getBytes( values,n*sizeof(double) ); }
+    bool get( std::string& s )
+    {
+      boost::uint32_t size;
+      if( (! get(size))||(remaining()<size) ) return false;
+      s.assign( cur,size ); cur += size;
+      return true;
+    }
+    bool get( bool& b )
+    {
+      boost::uint8_t v;
+      if(! get(v) ) return false;
+      b = ( 0!=v );
+      return true;
+    }
+  };
+
+  void writeModel( Writer& w,const ModelDescription& model )
+  {
+    w.put( boost::uint32_t(model.nbDof) );
+    w.put( boost::uint32_t(model.joints.size()) );
+    for( unsigned int i=0;i<model.joints.size();++i )
+      {
+	const ModelDescription::Joint& joint = model.joints[i];
+	w.put( joint.name );
+	w.put( boost::int32_t(joint.parent) );
+	w.put( boost::uint32_t(joint.type) );
+	w.put( boost::uint32_t(joint.rank) );
+	w.put( boost::uint32_t(joint.nbDof) );
+	w.put( joint.position,16 );
+	w.put( boost::uint32_t(joint.bounds.size()) );
+	if(! joint.bounds.empty() ) w.put( &joint.bounds[0],joint.bounds.size() );
+	w.put( joint.hasBody );
+	w.put( joint.mass );
+	w.put( joint.com,3 );
+	w.put( joint.inertia,9 );
+      }
+    for( unsigned int s=0;s<ModelDescription::NB_SPECIAL_JOINTS;++s )
+      w.put( boost::int32_t(model.specialJoints[s]) );
+    for( unsigned int side=0;side<2;++side )
+      {
+	const ModelDescription::Hand& hand = model.hands[side];
+	w.put( hand.present );
+	w.put( hand.center,3 ); w.put( hand.thumbAxis,3 );
+	w.put( hand.forefingerAxis,3 ); w.put( hand.palmNormal,3 );
+	const ModelDescription::Foot& foot = model.feet[side];
+	w.put( foot.present );
+	w.put( foot.soleLength ); w.put( foot.soleWidth );
+	w.put( foot.anklePosition,3 );
+      }
+    w.put( model.gazeOrigin,3 );
+    w.put( model.gazeDirection,3 );
+  }
+
+  bool readModel( Reader& r,ModelDescription& model )
+  {
+    boost::uint32_t nbDof,nbJoints;
+    if( (! r.get(nbDof))||(! r.get(nbJoints)) ) return false;
+    /* Do not trust the count for the allocation. */
+    if( nbJoints>r.remaining() ) return false;
+    model.nbDof = nbDof;
+    model.joints.resize( nbJoints );
+    for( unsigned int i=0;i<nbJoints;++i )
+      {
+	ModelDescription::Joint& joint = model.joints[i];
+	boost::int32_t parent;
+	boost::uint32_t type,rank,jointDof,nbBounds;
+	if( (! r.get(joint.name))||(! r.get(parent))||(! r.get(type))
+	    ||(! r.get(rank))||(! r.get(jointDof))||(! r.get(joint.position,16))
+	    ||(! r.get(nbBounds)) )
+	  return false;
+	if( (parent>=boost::int32_t(i))||(parent<-1)
+	    ||(type>ModelDescription::ANCHOR_JOINT)||(nbBounds!=6*jointDof)
+	    ||(nbBounds*sizeof(double)>r.remaining()) )
+	  return false;
+	joint.parent = parent; joint.type = type;
+	joint.rank = rank; joint.nbDof = jointDof;
+	joint.bounds.resize( nbBounds );
+	if( (nbBounds>0)&&(! r.get(&joint.bounds[0],nbBounds)) ) return false;
+	if( (! r.get(joint.hasBody))||(! r.get(joint.mass))
+	    ||(! r.get(joint.com,3))||(! r.get(joint.inertia,9)) )
+	  return false;
+      }
+    for( unsigned int s=0;s<ModelDescription::NB_SPECIAL_JOINTS;++s )
+      {
+	boost::int32_t index;
+	if( (! r.get(index))||(index<-1)||(index>=boost::int32_t(nbJoints)) )
+	  return false;
+	model.specialJoints[s] = index;
+      }
+    for( unsigned int side=0;side<2;++side )
+      {
+	ModelDescription::Hand& hand = model.hands[side];
+	ModelDescription::Foot& foot = model.feet[side];
+	if( (! r.get(hand.present))||(! r.get(hand.center,3))
+	    ||(! r.get(hand.thumbAxis,3))||(! r.get(hand.forefingerAxis,3))
+	    ||(! r.get(hand.palmNormal,3))
+	    ||(! r.get(foot.present))||(! r.get(foot.soleLength))
+	    ||(! r.get(foot.soleWidth))||(! r.get(foot.anklePosition,3)) )
+	  return false;
+      }
+    return r.get( model.gazeOrigin,3 )&&r.get( model.gazeDirection,3 )
+      &&( 0==r.remaining() );
+  }
+
+  /* Unmap on every exit path of load(). */
+  struct Mapping
+  {
+    Mapping( void ) : data(MAP_FAILED),size(0) {}
+    ~Mapping( void ) { if( MAP_FAILED!=data ) munmap( data,size ); }
+    void* data;
+    size_t size;
+  };
+}
+
+/* --------------------------------------------------------------------- */
+/* --- CACHE ----------------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+bool ModelCache::
+hashFile( const std::string& filename,Hash& hash )
+{
+  std::ifstream file( filename.c_str(),std::ios::in|std::ios::binary );
+  if(! file.is_open() ) return false;
+  hash = FNV_OFFSET;
+  char buffer[65536];
+  while( file )
+    {
+      file.read( buffer,sizeof(buffer) );
+      hash = fnv( buffer,file.gcount(),hash );
+    }
+  return file.eof();
+}
+
+std::string ModelCache::
+fileName( const std::string& directory,const std::vector<Hash>& hashes )
+{
+  std::ostringstream name;
+  name << directory << "/model";
+  for( unsigned int i=0;i<hashes.size();++i )
+    name << '-' << std::hex << std::setw(16) << std::setfill('0') << hashes[i];
+  name << ".bin";
+  return name.str();
+}
+
+bool ModelCache::
+save( const std::string& filename,const std::vector<Hash>& hashes,
+      const ModelDescription& model )
+{
+  Writer payload;
+  writeModel( payload,model );
+
+  Writer header;
+  header.buffer.append( MAGIC,sizeof(MAGIC) );
+  header.put( VERSION );
+  header.put( ENDIANNESS );
+  header.put( boost::uint32_t(hashes.size()) );
+  for( unsigned int i=0;i<hashes.size();++i ) header.put( hashes[i] );
+  header.put( boost::uint64_t(payload.buffer.size()) );
+  header.put( fnv( payload.buffer.data(),payload.buffer.size() ) );
+
+  /* Write aside then rename, which is atomic. */
+  std::ostringstream tmpName;
+  tmpName << filename << ".tmp" << getpid();
+  {
+    std::ofstream file( tmpName.str().c_str(),
+			std::ios::out|std::ios::binary|std::ios::trunc );
+    if(! file.is_open() ) return false;
+    file.write( header.buffer.data(),header.buffer.size() );
+    file.write( payload.buffer.data(),payload.buffer.size() );
+    file.close();
+    if( file.fail() ) { std::remove( tmpName.str().c_str() ); return false; }
+  }
+  if( 0!=std::rename( tmpName.str().c_str(),filename.c_str() ) )
+    {
+      std::remove( tmpName.str().c_str() );
+      return false;
+    }
+  return true;
+}
+
+bool ModelCache::
+load( const std::string& filename,const std::vector<Hash>& hashes,
+      ModelDescription& model )
+{
+  Mapping mapping;
+  {
+    const int fd = open( filename.c_str(),O_RDONLY );
+    if( fd<0 ) return false;
+    struct stat status;
+    if( (0==fstat( fd,&status ))&&(status.st_size>0) )
+      {
+	mapping.size = status.st_size;
+	mapping.data = mmap( 0,mapping.size,PROT_READ,MAP_PRIVATE,fd,0 );
+      }
+    close( fd );
+    if( MAP_FAILED==mapping.data ) return false;
+  }
+
+  Reader r( static_cast<const char*>(mapping.data),mapping.size );
+  char magic[sizeof(MAGIC)];
+  boost::uint32_t version,endianness,nbHashes;
+  if( (! r.getBytes(magic,sizeof(magic)))||(0!=memcmp( magic,MAGIC,sizeof(MAGIC) ))
+      ||(! r.get(version))||(VERSION!=version)
+      ||(! r.get(endianness))||(ENDIANNESS!=endianness)
+      ||(! r.get(nbHashes))||(nbHashes!=hashes.size()) )
+    return false;
+  for( unsigned int i=0;i<nbHashes;++i )
+    {
+      Hash hash;
+      if( (! r.get(hash))||(hash!=hashes[i]) ) return false;
+    }
+  boost::uint64_t payloadSize; Hash payloadHash;
+  if( (! r.get(payloadSize))||(! r.get(payloadHash))
+      ||(payloadSize!=r.remaining())
+      ||(payloadHash!=fnv( r.cur,r.remaining() )) )
+    return false;
+
+  return readModel( r,model );
+}
+
+/* --------------------------------------------------------------------- */
+/* --- SHARING --------------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+/* Descriptions in use, by hashes. Entities may be created from several
+ * threads. */
+static boost::mutex sharedDescriptionsMutex;
+static std::map< std::vector<ModelCache::Hash>,
+		 boost::weak_ptr<const ModelDescription> > sharedDescriptions;
+
+boost::shared_ptr<const ModelDescription> ModelCache::
+shared( const std::vector<Hash>& hashes )
+{
+  boost::lock_guard<boost::mutex> lock( sharedDescriptionsMutex );
+  std::map< std::vector<Hash>,boost::weak_ptr<const ModelDescription> >::iterator
+    it = sharedDescriptions.find( hashes );
+  if( it==sharedDescriptions.end() )
+    return boost::shared_ptr<const ModelDescription>();
+  return it->second.lock();
+}
+
+boost::shared_ptr<const ModelDescription> ModelCache::
+share( const std::vector<Hash>& hashes,const ModelDescription& model )
+{
+  boost::shared_ptr<const ModelDescription> description
+    ( new ModelDescription( model ) );
+  boost::lock_guard<boost::mutex> lock( sharedDescriptionsMutex );
+  sharedDescriptions[hashes] = description;
+  return description;
+}
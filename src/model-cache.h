@@ -0,0 +1,159 @@
+/*
+ * Copyright 2010,
+ * François Bleibel,
+ * Olivier Stasse,
+ *
+ * CNRS/AIST
+ *
+ * This file is part of sot-dynamic.
+ * sot-dynamic is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ * sot-dynamic is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.  You should
+ * have received a copy of the GNU Lesser General Public License along
+ * with sot-dynamic.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SOT_MODEL_CACHE_H__
+#define __SOT_MODEL_CACHE_H__
+
+/* --------------------------------------------------------------------- */
+/* --- INCLUDE --------------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+/* STD */
+#include <string>
+#include <vector>
+
+/* BOOST */
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+/* JRL */
+#include <abstract-robot-dynamics/humanoid-dynamic-robot.hh>
+
+/* --------------------------------------------------------------------- */
+/* --- CLASS ----------------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+namespace dynamicgraph { namespace sot {
+
+/*! \brief Everything needed to rebuild a parsed robot with the
+  construction commands of Dynamic (createJoint, addJoint, setMass...).
+*/
+struct ModelDescription
+{
+  enum JointType
+  {
+    FREEFLYER_JOINT=0,
+    ROTATION_JOINT,
+    TRANSLATION_JOINT,
+    ANCHOR_JOINT
+  };
+
+  struct Joint
+  {
+    std::string name;
+    /// Index of the parent joint, -1 for the root.
+    int parent;
+    unsigned int type;
+    unsigned int rank;
+    unsigned int nbDof;
+    /// Initial position, row-major.
+    double position[16];
+    /// Lower and upper position, velocity and torque bounds, nbDof each.
+    std::vector<double> bounds;
+    bool hasBody;
+    double mass;
+    double com[3];
+    double inertia[9];
+  };
+
+  /// Indices of the special joints, -1 if not set.
+  enum SpecialJoint
+  {
+    WAIST=0, CHEST, LEFT_WRIST, RIGHT_WRIST, LEFT_ANKLE, RIGHT_ANKLE, GAZE,
+    NB_SPECIAL_JOINTS
+  };
+
+  struct Hand
+  {
+    bool present;
+    double center[3];
+    double thumbAxis[3];
+    double forefingerAxis[3];
+    double palmNormal[3];
+  };
+
+  struct Foot
+  {
+    bool present;
+    double soleLength;
+    double soleWidth;
+    double anklePosition[3];
+  };
+
+  unsigned int nbDof;
+  /// Parents come first.
+  std::vector<Joint> joints;
+  int specialJoints[NB_SPECIAL_JOINTS];
+  /// Left then right.
+  Hand hands[2];
+  Foot feet[2];
+  double gazeOrigin[3];
+  double gazeDirection[3];
+
+  /*! \brief Read the model of robot. Its forward kinematics is computed at
+    the zero configuration to tell the joint types apart, then at its
+    previous configuration again.
+    \return false if the robot cannot be described, for instance if a
+    joint has a number of dofs other than 0, 1 or 6. */
+  bool capture( CjrlHumanoidDynamicRobot& robot );
+
+ private:
+  /// Read the model, the forward kinematics being done.
+  bool read( CjrlHumanoidDynamicRobot& robot );
+};
+
+/*! \brief On-disk binary cache of parsed models.
+
+  A cache file is named and keyed by the hashes of the contents of the
+  files the model was parsed from, and starts with a version and an
+  endianness mark: any mismatch rejects the file. It is written to a
+  temporary file then renamed, so that a concurrent reader never sees a
+  partial file, and read through a memory mapping.
+*/
+class ModelCache
+{
+ public:
+  typedef boost::uint64_t Hash;
+
+  /// FNV-1a hash of the contents of a file.
+  static bool hashFile( const std::string& filename,Hash& hash );
+
+  /// Cache file of the model parsed from files of the given hashes.
+  static std::string fileName( const std::string& directory,
+			       const std::vector<Hash>& hashes );
+
+  static bool save( const std::string& filename,const std::vector<Hash>& hashes,
+		    const ModelDescription& model );
+  static bool load( const std::string& filename,const std::vector<Hash>& hashes,
+		    ModelDescription& model );
+
+  /*! \brief Description of the files of the given hashes, registered by
+    share() in this process and still held by an entity, 0 otherwise. */
+  static boost::shared_ptr<const ModelDescription>
+    shared( const std::vector<Hash>& hashes );
+  /*! \brief Register model as the description of the files of the given
+    hashes, for the entities that parse them afterwards. */
+  static boost::shared_ptr<const ModelDescription>
+    share( const std::vector<Hash>& hashes,const ModelDescription& model );
+};
+
+} /* namespace sot */} /* namespace dynamicgraph */
+
+#endif // #ifndef __SOT_MODEL_CACHE_H__
@@ -0,0 +1,392 @@
+/*
+ * Copyright 2010,
+ * François Bleibel,
+ * Olivier Stasse,
+ *
+ * CNRS/AIST
+ *
+ * This file is part of sot-dynamic.
+ * sot-dynamic is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ * sot-dynamic is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.  You should
+ * have received a copy of the GNU Lesser General Public License along
+ * with sot-dynamic.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rigid-body-tree.h"
+
+#include <map>
+#include <cmath>
+#include <algorithm>
+
+#include <boost/weak_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#include <jrl/mal/matrixabstractlayer.hh>
+
+using namespace dynamicgraph::sot;
+using namespace dynamicgraph::sot::spatial;
+
+/* --------------------------------------------------------------------- */
+/* --- MODEL ----------------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+static void readTransformation( const matrix4d& m4,Matrix3& R,Vector3& p )
+{
+  for( unsigned int i=0;i<3;++i )
+    {
+      for( unsigned int j=0;j<3;++j )
+	R(i,j) = MAL_S4x4_MATRIX_ACCESS_I_J(m4,i,j);
+      p[i] = MAL_S4x4_MATRIX_ACCESS_I_J(m4,i,3);
+    }
+}
+
+boost::shared_ptr<const RigidBodyModel> RigidBodyModel::
+build( const std::vector<CjrlJoint*>& joints,unsigned int nbDof )
+{
+  boost::shared_ptr<RigidBodyModel> model( new RigidBodyModel );
+  model->nbDof = nbDof;
+  model->links.resize( joints.size() );
+  for( unsigned int i=0;i<joints.size();++i )
+    {
+      Link& link = model->links[i];
+      CjrlJoint* joint = joints[i];
+      link.parent = -1;
+      for( unsigned int j=0;j<i;++j )
+	if( joints[j]==joint->parentJoint() ) link.parent = j;
+      link.rank = joint->rankInConfiguration();
+      link.nbDof = joint->numberDof();
+
+      link.mass = 0.;
+      link.localCom = Vector3();
+      link.localInertia = Matrix3();
+      const CjrlBody* linkedBody = joint->linkedBody();
+      if( 0!=linkedBody )
+	{
+	  link.mass = linkedBody->mass();
+	  const vector3d& c = linkedBody->localCenterOfMass();
+	  const matrix3d& I = linkedBody->inertiaMatrix();
+	  for( unsigned int r=0;r<3;++r )
+	    {
+	      link.localCom[r] = MAL_S3_VECTOR_ACCESS(c,r);
+	      for( unsigned int s=0;s<3;++s )
+		link.localInertia(r,s) = MAL_S3x3_MATRIX_ACCESS_I_J(I,r,s);
+	    }
+	}
+
+      /* Own columns of the joint jacobian: linear velocity of the joint
+       * origin (rows 0-2) and angular velocity (rows 3-5). */
+      link.worldAxes = ( (link.parent<0)&&(6==link.nbDof) );
+      link.axes.resize( link.nbDof );
+      if( link.nbDof>0 )
+	{
+	  joint->computeJacobianJointWrtConfig();
+	  const matrixNxP& J = joint->jacobianJointWrtConfig();
+	  Matrix3 R; Vector3 p;
+	  readTransformation( joint->currentTransformation(),R,p );
+	  for( unsigned int k=0;k<link.nbDof;++k )
+	    {
+	      const unsigned int col = link.rank+k;
+	      Motion axis( Vector3( J(3,col),J(4,col),J(5,col) ),
+			   Vector3( J(0,col),J(1,col),J(2,col) ) );
+	      if( link.worldAxes ) link.axes[k] = axis;
+	      else
+		link.axes[k] = Motion( transposeMultiply( R,axis.angular ),
+				       transposeMultiply( R,axis.linear ) );
+	    }
+	}
+    }
+  return model;
+}
+
+/* Models in use, by key. Entities may be created from several threads. */
+static boost::mutex sharedModelsMutex;
+static std::map< std::string,boost::weak_ptr<const RigidBodyModel> > sharedModels;
+
+boost::shared_ptr<const RigidBodyModel> RigidBodyModel::
+shared( const std::string& key,const std::vector<CjrlJoint*>& joints,
+	unsigned int nbDof )
+{
+  boost::lock_guard<boost::mutex> lock( sharedModelsMutex );
+  boost::weak_ptr<const RigidBodyModel>& entry = sharedModels[key];
+  boost::shared_ptr<const RigidBodyModel> model = entry.lock();
+  if( (0==model)||(model->links.size()!=joints.size())||(model->nbDof!=nbDof) )
+    {
+      model = build( joints,nbDof );
+      entry = model;
+    }
+  return model;
+}
+
+/* --------------------------------------------------------------------- */
+/* --- CONSTRUCTION ---------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+RigidBodyTree::
+RigidBodyTree( void )
+  :ready_(false)
+  ,buildCount_(0)
+  ,model_( new RigidBodyModel() )
+  ,bodies_()
+{}
+
+void RigidBodyTree::
+build( CjrlHumanoidDynamicRobot& robot,const std::string& key )
+{
+  /* Breadth-first, so that parents come first. */
+  std::vector<CjrlJoint*> joints;
+  if( 0!=robot.rootJoint() ) joints.push_back( robot.rootJoint() );
+  for( unsigned int i=0;i<joints.size();++i )
+    for( unsigned int k=0;k<joints[i]->countChildJoints();++k )
+      joints.push_back( joints[i]->childJoint(k) );
+
+  if( key.empty() ) model_ = RigidBodyModel::build( joints,robot.numberDof() );
+  else model_ = RigidBodyModel::shared( key,joints,robot.numberDof() );
+
+  bodies_.resize( joints.size() );
+  for( unsigned int i=0;i<joints.size();++i )
+    {
+      bodies_[i].joint = joints[i];
+      const unsigned int nbDof = model_->links[i].nbDof;
+      bodies_[i].S.resize( nbDof );
+      bodies_[i].U.resize( nbDof );
+      bodies_[i].Dinv.resize( nbDof*nbDof );
+      bodies_[i].u.resize( nbDof );
+    }
+  ready_ = true;
+  ++buildCount_;
+}
+
+int RigidBodyTree::
+index( const CjrlJoint* joint ) const
+{
+  for( unsigned int i=0;i<bodies_.size();++i )
+    if( bodies_[i].joint==joint ) return i;
+  return -1;
+}
+
+/* --------------------------------------------------------------------- */
+/* --- UPDATE ---------------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+void RigidBodyTree::
+updatePositions( void )
+{
+  for( unsigned int i=0;i<bodies_.size();++i )
+    {
+      Body& body = bodies_[i];
+      const Link& link = model_->links[i];
+      readTransformation( body.joint->currentTransformation(),body.R,body.p );
+
+      for( unsigned int k=0;k<link.nbDof;++k )
+	{
+	  const Motion& axis = link.axes[k];
+	  const Vector3 w = link.worldAxes ? axis.angular : body.R*axis.angular;
+	  const Vector3 vp = link.worldAxes ? axis.linear : body.R*axis.linear;
+	  /* Velocity of the point at the world origin. */
+	  body.S[k] = Motion( w,vp - cross( w,body.p ) );
+	}
+
+      body.com = body.p + body.R*link.localCom;
+      const Matrix3 Ic = body.R*link.localInertia*body.R.transpose();
+      body.inertia = Inertia::fromBody( link.mass,body.com,Ic );
+    }
+}
+
+void RigidBodyTree::
+updateVelocities( const ml::Vector& dq )
+{
+  for( unsigned int i=0;i<bodies_.size();++i )
+    {
+      Body& body = bodies_[i];
+      const Link& link = model_->links[i];
+      Motion vJ;
+      for( unsigned int k=0;k<link.nbDof;++k )
+	vJ += dq(link.rank+k)*body.S[k];
+
+      if( link.parent<0 ) { body.v = vJ; body.c = Motion(); }
+      else
+	{
+	  const Body& parent = bodies_[link.parent];
+	  body.v = parent.v + vJ;
+	  body.c = parent.c;
+	}
+
+      if( link.worldAxes )
+	{
+	  /* Constant world axes: only the term -w x dp/dt of the linear
+	   * part, due to the motion of the reference point, remains. */
+	  const Vector3 dp = vJ.pointVelocity( body.p );
+	  body.c += Motion( Vector3(),-cross( vJ.angular,dp ) );
+	}
+      else
+	body.c += cross( body.v,vJ );
+    }
+}
+
+/* --------------------------------------------------------------------- */
+/* --- INVERSE DYNAMICS ------------------------------------------------ */
+/* --------------------------------------------------------------------- */
+
+/* Recursive Newton-Euler, in the world frame. The gravity is accounted
+ * for by a fictitious acceleration -g of the world. */
+
+void RigidBodyTree::
+gravityTorques( const Vector3& g,ml::Vector& tau )
+{
+  const Motion a0( Vector3(),-g );
+  for( unsigned int i=0;i<bodies_.size();++i )
+    bodies_[i].f = bodies_[i].inertia*a0;
+  projectForces( tau );
+}
+
+void RigidBodyTree::
+biasTorques( const Vector3& g,ml::Vector& tau )
+{
+  const Motion a0( Vector3(),-g );
+  for( unsigned int i=0;i<bodies_.size();++i )
+    {
+      Body& body = bodies_[i];
+      const Force h = body.inertia*body.v;
+      body.f = body.inertia*( a0+body.c ) + cross( body.v,h );
+    }
+  projectForces( tau );
+}
+
+void RigidBodyTree::
+projectForces( ml::Vector& tau )
+{
+  if( tau.size()!=model_->nbDof ) tau.resize( model_->nbDof );
+  for( unsigned int i=bodies_.size();i-->0; )
+    {
+      const Body& body = bodies_[i];
+      const Link& link = model_->links[i];
+      for( unsigned int k=0;k<link.nbDof;++k )
+	tau(link.rank+k) = dot( body.S[k],body.f );
+      if( link.parent>=0 ) bodies_[link.parent].f += body.f;
+    }
+}
+
+/* --------------------------------------------------------------------- */
+/* --- FORWARD DYNAMICS ------------------------------------------------ */
+/* --------------------------------------------------------------------- */
+
+/* Invert the n x n matrix M (row-major) in place, by Gauss-Jordan
+ * elimination with partial pivoting. n is at most 6. */
+static bool invertSmall( std::vector<double>& M,const unsigned int n )
+{
+  double inv[36];
+  for( unsigned int i=0;i<n*n;++i ) inv[i] = 0.;
+  for( unsigned int i=0;i<n;++i ) inv[i*n+i] = 1.;
+
+  for( unsigned int c=0;c<n;++c )
+    {
+      unsigned int pivot = c;
+      for( unsigned int r=c+1;r<n;++r )
+	if( std::fabs( M[r*n+c] )>std::fabs( M[pivot*n+c] ) ) pivot = r;
+      if( std::fabs( M[pivot*n+c] )<1e-12 ) return false;
+      if( pivot!=c )
+	for( unsigned int k=0;k<n;++k )
+	  {
+	    std::swap( M[pivot*n+k],M[c*n+k] );
+	    std::swap( inv[pivot*n+k],inv[c*n+k] );
+	  }
+      const double d = 1./M[c*n+c];
+      for( unsigned int k=0;k<n;++k ) { M[c*n+k] *= d; inv[c*n+k] *= d; }
+      for( unsigned int r=0;r<n;++r )
+	{
+	  if( r==c ) continue;
+	  const double e = M[r*n+c];
+	  if( 0.==e ) continue;
+	  for( unsigned int k=0;k<n;++k )
+	    {
+	      M[r*n+k] -= e*M[c*n+k];
+	      inv[r*n+k] -= e*inv[c*n+k];
+	    }
+	}
+    }
+  std::copy( inv,inv+n*n,M.begin() );
+  return true;
+}
+
+/* Articulated body algorithm, in the world frame: since all the spatial
+ * quantities are expressed at the world origin, no transformation is
+ * needed between a body and its parent. The velocity-product
+ * acceleration of a joint is the difference of the accumulated ones c
+ * of its body and of its parent. */
+
+bool RigidBodyTree::
+forwardDynamics( const Vector3& g,const ml::Vector& tau,ml::Vector& ddq )
+{
+  const unsigned int nbBodies = bodies_.size();
+  for( unsigned int i=0;i<nbBodies;++i )
+    {
+      Body& body = bodies_[i];
+      body.IA = ArticulatedInertia( body.inertia );
+      body.pA = cross( body.v,body.inertia*body.v );
+    }
+
+  for( unsigned int i=nbBodies;i-->0; )
+    {
+      Body& body = bodies_[i];
+      const Link& link = model_->links[i];
+      const unsigned int n = link.nbDof;
+      for( unsigned int j=0;j<n;++j )
+	{
+	  body.U[j] = body.IA*body.S[j];
+	  body.u[j] = tau(link.rank+j) - dot( body.S[j],body.pA );
+	}
+      for( unsigned int j=0;j<n;++j )
+	for( unsigned int k=0;k<n;++k )
+	  body.Dinv[j*n+k] = dot( body.S[j],body.U[k] );
+      if(! invertSmall( body.Dinv,n ) ) return false;
+      if( link.parent<0 ) continue;
+
+      Body& parent = bodies_[link.parent];
+      ArticulatedInertia Ia = body.IA;
+      Force pa = body.pA;
+      for( unsigned int j=0;j<n;++j )
+	{
+	  double Dinvu = 0.;
+	  for( unsigned int k=0;k<n;++k )
+	    {
+	      Ia.addOuter( -body.Dinv[j*n+k],body.U[j],body.U[k] );
+	      Dinvu += body.Dinv[j*n+k]*body.u[k];
+	    }
+	  pa += Dinvu*body.U[j];
+	}
+      pa += Ia*( body.c - parent.c );
+      parent.IA += Ia;
+      parent.pA += pa;
+    }
+
+  if( ddq.size()!=model_->nbDof ) ddq.resize( model_->nbDof );
+  const Motion a0( Vector3(),-g );
+  for( unsigned int i=0;i<nbBodies;++i )
+    {
+      Body& body = bodies_[i];
+      const Link& link = model_->links[i];
+      const unsigned int n = link.nbDof;
+      body.a = ( link.parent<0 )
+	? a0 + body.c
+	: bodies_[link.parent].a + ( body.c - bodies_[link.parent].c );
+
+      double rhs[6];
+      for( unsigned int j=0;j<n;++j )
+	rhs[j] = body.u[j] - dot( body.a,body.U[j] );
+      for( unsigned int j=0;j<n;++j )
+	{
+	  double qdd = 0.;
+	  for( unsigned int k=0;k<n;++k ) qdd += body.Dinv[j*n+k]*rhs[k];
+	  ddq(link.rank+j) = qdd;
+	  body.a += qdd*body.S[j];
+	}
+    }
+  return true;
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright 2010,
+ * François Bleibel,
+ * Olivier Stasse,
+ *
+ * CNRS/AIST
+ *
+ * This file is part of sot-dynamic.
+ * sot-dynamic is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ * sot-dynamic is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.  You should
+ * have received a copy of the GNU Lesser General Public License along
+ * with sot-dynamic.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SOT_RIGID_BODY_TREE_H__
+#define __SOT_RIGID_BODY_TREE_H__
+
+/* --------------------------------------------------------------------- */
+/* --- INCLUDE --------------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+/* STD */
+#include <string>
+#include <vector>
+
+/* BOOST */
+#include <boost/shared_ptr.hpp>
+
+/* Matrix */
+#include <jrl/mal/boost.hh>
+namespace ml = maal::boost;
+
+/* JRL */
+#include <abstract-robot-dynamics/humanoid-dynamic-robot.hh>
+
+/* SOT */
+#include <sot-dynamic/spatial-algebra.h>
+
+/* --------------------------------------------------------------------- */
+/* --- CLASS ----------------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+namespace dynamicgraph { namespace sot {
+
+/*! \brief Static data of a kinematic tree: topology, masses and joint
+  axes, in the order of RigidBodyTree.
+
+  It never changes once built, so that the entities parsing the same
+  model files share one instance, see shared().
+*/
+struct RigidBodyModel
+{
+  struct Link
+  {
+    /// Index of the parent link, -1 for the root.
+    int parent;
+    unsigned int rank;
+    unsigned int nbDof;
+    double mass;
+    spatial::Vector3 localCom;
+    /// Rotational inertia about the center of mass, in the joint frame.
+    spatial::Matrix3 localInertia;
+    /// Motion subspace as (angular velocity, velocity of the joint
+    /// origin), one per dof.
+    std::vector<spatial::Motion> axes;
+    bool worldAxes;
+  };
+
+  unsigned int nbDof;
+  std::vector<Link> links;
+
+  /*! \brief Read the model of robot from its joints, sorted parent
+    first. The forward kinematics must have been computed, since the
+    joint axes are read from the jacobians. */
+  static boost::shared_ptr<const RigidBodyModel>
+    build( const std::vector<CjrlJoint*>& joints,unsigned int nbDof );
+
+  /*! \brief Model registered under key by a previous call, still in use,
+    or the one built by build() otherwise. */
+  static boost::shared_ptr<const RigidBodyModel>
+    shared( const std::string& key,const std::vector<CjrlJoint*>& joints,
+	    unsigned int nbDof );
+};
+
+/*! \brief World-frame image of the kinematic tree of a jrl robot, for the
+  recursive algorithms that jrl-dynamics does not provide.
+
+  The bodies are sorted so that a parent always comes before its
+  children: forward passes iterate upward, backward passes downward.
+  Poses are read from the joints after the forward kinematics of
+  jrl-dynamics, so that both always agree.
+
+  The motion subspace of each joint is read once from its own columns
+  of the jrl jacobian, which makes the conventions of the outputs
+  (free-flyer parameterization, prismatic joints...) those of jrl. It is
+  stored in the joint frame, except for a free-flyer root whose columns
+  are constant in the world frame.
+
+  The static data live in a RigidBodyModel, possibly shared with other
+  trees; the tree itself only holds the state.
+*/
+class RigidBodyTree
+{
+ public:
+  typedef RigidBodyModel::Link Link;
+
+  /// State of a body at the last update, in the world frame.
+  struct Body
+  {
+    CjrlJoint* joint;
+    spatial::Matrix3 R;
+    spatial::Vector3 p;
+    spatial::Vector3 com;
+    /// Motion subspace, in Plucker coordinates at the world origin.
+    std::vector<spatial::Motion> S;
+    /// Spatial inertia at the world origin.
+    spatial::Inertia inertia;
+    /// Spatial velocity.
+    spatial::Motion v;
+    /// Spatial acceleration due to the velocities only (zero joint
+    /// accelerations, no gravity).
+    spatial::Motion c;
+    /// Force transmitted by the joint, at the world origin (scratch of
+    /// the inverse dynamics passes).
+    spatial::Force f;
+    /// \name Scratch of the forward dynamics.
+    ///@{
+    /// Articulated inertia and bias force of the subtree.
+    spatial::ArticulatedInertia IA;
+    spatial::Force pA;
+    spatial::Motion a;
+    /// IA.S, inverse of S'.IA.S (row-major) and tau - S'.pA.
+    std::vector<spatial::Force> U;
+    std::vector<double> Dinv;
+    std::vector<double> u;
+    ///@}
+  };
+
+  RigidBodyTree( void );
+
+  /*! \brief Forget the model. To be called when the tree or the masses
+    change. */
+  void invalidate( void ) { ready_ = false; }
+  bool ready( void ) const { return ready_; }
+  /// Number of calls to build: the indices of the bodies only change
+  /// with it.
+  unsigned int buildCount( void ) const { return buildCount_; }
+
+  /*! \brief Read the model of robot. The forward kinematics must have
+    been computed, since the joint axes are read from the jacobians.
+    \param key identifies the model files robot was parsed from: trees
+    built with the same nonempty key share their static data. Empty for a
+    model built or edited by hand. */
+  void build( CjrlHumanoidDynamicRobot& robot,const std::string& key="" );
+
+  /*! \brief Read the joint poses and compute the world axes, centers of
+    mass and inertias. */
+  void updatePositions( void );
+
+  /*! \brief Compute the body velocities and velocity-product
+    accelerations for the joint velocity dq. Requires updatePositions. */
+  void updateVelocities( const ml::Vector& dq );
+
+  /*! \brief Joint torques g(q) balancing the gravity g (a 3D vector, for
+    instance (0,0,-9.81)), with zero velocities and accelerations.
+    Requires updatePositions. */
+  void gravityTorques( const spatial::Vector3& g,ml::Vector& tau );
+
+  /*! \brief Joint torques C(q,dq).dq + g(q) at zero joint acceleration.
+    Requires updateVelocities. */
+  void biasTorques( const spatial::Vector3& g,ml::Vector& tau );
+
+  /*! \brief Joint accelerations ddq = M^-1.(tau - C(q,dq).dq - g(q)),
+    computed by the articulated body algorithm without forming M.
+    Requires updateVelocities.
+    \return false if the articulated inertia seen by a joint is
+    singular, for instance behind a massless leaf. */
+  bool forwardDynamics( const spatial::Vector3& g,const ml::Vector& tau,
+			ml::Vector& ddq );
+
+  unsigned int numberDof( void ) const { return model_->nbDof; }
+  unsigned int size( void ) const { return bodies_.size(); }
+  const RigidBodyModel& model( void ) const { return *model_; }
+  const Link& link( const unsigned int i ) const { return model_->links[i]; }
+  Body& operator[]( const unsigned int i ) { return bodies_[i]; }
+  const Body& operator[]( const unsigned int i ) const { return bodies_[i]; }
+  /// Index of the body of joint, -1 if not in the tree.
+  int index( const CjrlJoint* joint ) const;
+
+ private:
+  /*! \brief Project the body forces on the joint axes, accumulating them
+    from the leaves to the root. */
+  void projectForces( ml::Vector& tau );
+
+  bool ready_;
+  unsigned int buildCount_;
+  boost::shared_ptr<const RigidBodyModel> model_;
+  std::vector<Body> bodies_;
+};
+
+} /* namespace sot */} /* namespace dynamicgraph */
+
+#endif // #ifndef __SOT_RIGID_BODY_TREE_H__
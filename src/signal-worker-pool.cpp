@@ -0,0 +1,107 @@
+/*
+ * Copyright 2010,
+ * François Bleibel,
+ * Olivier Stasse,
+ *
+ * CNRS/AIST
+ *
+ * This file is part of sot-dynamic.
+ * sot-dynamic is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ * sot-dynamic is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.  You should
+ * have received a copy of the GNU Lesser General Public License along
+ * with sot-dynamic.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "signal-worker-pool.h"
+
+#include <exception>
+#include <boost/bind.hpp>
+
+using namespace dynamicgraph::sot;
+
+SignalWorkerPool::
+SignalWorkerPool( const unsigned int nbThreads )
+  :tasks_(0)
+  ,time_(0)
+  ,next_(0)
+  ,pending_(0)
+  ,error_()
+  ,stop_(false)
+  ,threads_()
+{
+  for( unsigned int i=0;i<nbThreads;++i )
+    threads_.push_back( new boost::thread( boost::bind(&SignalWorkerPool::work,this) ) );
+}
+
+SignalWorkerPool::
+~SignalWorkerPool( void )
+{
+  {
+    boost::unique_lock<boost::mutex> lock( mutex_ );
+    stop_ = true;
+  }
+  wakeUp_.notify_all();
+  for( unsigned int i=0;i<threads_.size();++i )
+    {
+      threads_[i]->join();
+      delete threads_[i];
+    }
+}
+
+bool SignalWorkerPool::
+run( const std::vector<Task>& tasks,int time,std::string& error )
+{
+  const unsigned int NBTASKS = tasks.size();
+  if( 0==NBTASKS ) return true;
+
+  boost::unique_lock<boost::mutex> lock( mutex_ );
+  tasks_ = &tasks;
+  time_ = time;
+  next_ = 0;
+  pending_ = NBTASKS;
+  error_.clear();
+  wakeUp_.notify_all();
+
+  while( next_<NBTASKS ) runNext( lock );
+  while( pending_>0 ) done_.wait( lock );
+
+  tasks_ = 0;
+  error = error_;
+  return error_.empty();
+}
+
+void SignalWorkerPool::
+work( void )
+{
+  boost::unique_lock<boost::mutex> lock( mutex_ );
+  for( ;; )
+    {
+      while( (! stop_)&&( (0==tasks_)||(next_>=tasks_->size()) ) )
+	wakeUp_.wait( lock );
+      if( stop_ ) return;
+      runNext( lock );
+    }
+}
+
+void SignalWorkerPool::
+runNext( boost::unique_lock<boost::mutex>& lock )
+{
+  const Task& task = (*tasks_)[next_++];
+  const int time = time_;
+  std::string error;
+
+  lock.unlock();
+  try { task( time ); }
+  catch( const std::exception& e ) { error = e.what(); }
+  catch( ... ) { error = "unknown exception"; }
+  lock.lock();
+
+  if( (! error.empty())&&error_.empty() ) error_ = error;
+  if( 0==--pending_ ) done_.notify_all();
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2010,
+ * François Bleibel,
+ * Olivier Stasse,
+ *
+ * CNRS/AIST
+ *
+ * This file is part of sot-dynamic.
+ * sot-dynamic is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ * sot-dynamic is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.  You should
+ * have received a copy of the GNU Lesser General Public License along
+ * with sot-dynamic.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SOT_SIGNAL_WORKER_POOL_H__
+#define __SOT_SIGNAL_WORKER_POOL_H__
+
+/* --------------------------------------------------------------------- */
+/* --- INCLUDE --------------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+/* STD */
+#include <string>
+#include <vector>
+
+/* BOOST */
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+/* --------------------------------------------------------------------- */
+/* --- CLASS ----------------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+namespace dynamicgraph { namespace sot {
+
+/*! \brief Fixed set of threads running batches of independent tasks.
+
+  The threads are created once and sleep between two batches. The
+  calling thread takes part in the batch, so a pool of n threads runs
+  n+1 tasks at the same time.
+*/
+class SignalWorkerPool
+{
+ public:
+  typedef boost::function<void (int)> Task;
+
+  explicit SignalWorkerPool( const unsigned int nbThreads );
+  ~SignalWorkerPool( void );
+
+  unsigned int size( void ) const { return threads_.size(); }
+
+  /*! \brief Run task(time) for every task and return when all are done.
+    \return false if a task threw, with the message of the first error
+    in error. */
+  bool run( const std::vector<Task>& tasks,int time,std::string& error );
+
+ private:
+  void work( void );
+  /// Run the next task of the batch. The lock is released meanwhile.
+  void runNext( boost::unique_lock<boost::mutex>& lock );
+
+  boost::mutex mutex_;
+  boost::condition_variable wakeUp_;
+  boost::condition_variable done_;
+  /// Current batch, 0 between two batches.
+  const std::vector<Task>* tasks_;
+  int time_;
+  unsigned int next_;
+  unsigned int pending_;
+  std::string error_;
+  bool stop_;
+  std::vector<boost::thread*> threads_;
+};
+
+} /* namespace sot */} /* namespace dynamicgraph */
+
+#endif // #ifndef __SOT_SIGNAL_WORKER_POOL_H__
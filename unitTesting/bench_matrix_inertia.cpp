@@ -0,0 +1,105 @@
+/*
+ * Copyright 2010,
+ * François Bleibel,
+ * Olivier Stasse,
+ *
+ * CNRS/AIST
+ *
+ * This file is part of sot-dynamic.
+ * sot-dynamic is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ * sot-dynamic is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.  You should
+ * have received a copy of the GNU Lesser General Public License along
+ * with sot-dynamic.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Time of the inertia matrix computed by MatrixInertia against the one of
+ * jrl-dynamics, on the sample model. The values are checked by
+ * test_matrix_inertia. */
+
+#include <string>
+#include <cmath>
+#include <vector>
+#include <sys/time.h>
+#include <jrl/mal/matrixabstractlayer.hh>
+#include "jrl/dynamics/dynamicsfactory.hh"
+#include <sot-dynamic/matrix-inertia.h>
+using namespace std;
+using namespace dynamicgraph::sot;
+
+static double now( void )
+{
+  struct timeval tv; gettimeofday( &tv,0x0 );
+  return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc!=5)
+    {
+      cerr << "Usage:" << endl;
+      cerr << "./" << argv[0] << " DIR_OF_VRML_MODEL VRML_MODEL_FILENAME PATH_TO_SPECIFICITIES_FILE PATH_TO_LINK2JOINT_FILE " << endl;
+      return 77;
+    }
+
+  dynamicsJRLJapan::ObjectFactory aRobotDynamicsObjectConstructor;
+  CjrlHumanoidDynamicRobot * aHDR = aRobotDynamicsObjectConstructor.createHumanoidDynamicRobot();
+  string RobotFileName = string(argv[1]) + argv[2];
+  try
+    {
+      dynamicsJRLJapan::parseOpenHRPVRMLFile(*aHDR,RobotFileName,argv[4],argv[3]);
+    }
+  catch (...) {}
+  if( aHDR->numberDof()==0 )
+    {
+      cout << "Could not locate the necessary files for this benchmark" << endl;
+      return 77;
+    }
+
+  const int NbOfDofs = aHDR->numberDof();
+  MAL_VECTOR_DIM(aCurrentConf,double,NbOfDofs);
+  for( int i=0;i<NbOfDofs;++i )
+    aCurrentConf[i] = ( i<6 ) ? 0.0 : 0.3*sin( 1.+i );
+  aHDR->currentConfiguration(aCurrentConf);
+  aHDR->computeForwardKinematics();
+
+  MatrixInertia matrixInertia( aHDR );
+  const unsigned int n = matrixInertia.getDimension();
+  std::vector<double> packed( MatrixInertia::bufferSize( n,MatrixInertia::PACKED_UPPER ) );
+
+  const unsigned int NB_ITERATIONS = 1000;
+  double start = now();
+  for( unsigned int it=0;it<NB_ITERATIONS;++it )
+    aHDR->computeInertiaMatrix();
+  const double timeJrl = ( now()-start )/NB_ITERATIONS;
+
+  start = now();
+  for( unsigned int it=0;it<NB_ITERATIONS;++it )
+    {
+      matrixInertia.update();
+      matrixInertia.computeInertiaMatrix();
+    }
+  const double timeSot = ( now()-start )/NB_ITERATIONS;
+
+  start = now();
+  for( unsigned int it=0;it<NB_ITERATIONS;++it )
+    {
+      matrixInertia.update();
+      matrixInertia.computeInertiaMatrix( &packed[0],MatrixInertia::PACKED_UPPER );
+    }
+  const double timePacked = ( now()-start )/NB_ITERATIONS;
+
+  cout << "Dofs: " << NbOfDofs << endl;
+  cout << "jrl-dynamics: " << timeJrl*1e6 << " us" << endl;
+  cout << "MatrixInertia: " << timeSot*1e6 << " us" << endl;
+  cout << "MatrixInertia, packed: " << timePacked*1e6 << " us" << endl;
+  cout << "Speedup: " << timeJrl/timeSot << endl;
+
+  delete aHDR;
+  return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2010,
+ * François Bleibel,
+ * Olivier Stasse,
+ *
+ * CNRS/AIST
+ *
+ * This file is part of sot-dynamic.
+ * sot-dynamic is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ * sot-dynamic is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.  You should
+ * have received a copy of the GNU Lesser General Public License along
+ * with sot-dynamic.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Per-call cost of the joint position, with the frame correction derived
+ * at each call as before and with the cached one. The values are checked
+ * by test_position. */
+
+/* -------------------------------------------------------------------------- */
+/* --- INCLUDES ------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+#include <sot-dynamic/dynamic.h>
+#include <sys/time.h>
+#include <iostream>
+#include <cstring>
+
+using namespace std;
+using namespace dynamicgraph::sot;
+
+/* Give access to the protected position kernels. */
+class DynamicBench : public Dynamic
+{
+public:
+  DynamicBench( const std::string& name ) : Dynamic(name) {}
+  using Dynamic::computeFrameCorrection;
+  using Dynamic::composeJointPosition;
+};
+
+/* Position computation as done before the correction was cached: element
+ * copy of the transform, then correction derived from the initial
+ * position at each call. */
+static void legacyJointPosition( CjrlJoint* aJoint,MatrixHomogeneous& res )
+{
+  const matrix4d & m4 = aJoint->currentTransformation();
+  res.resize(4,4);
+  for( int i=0;i<4;++i )
+    for( int j=0;j<4;++j )
+      res(i,j) = MAL_S4x4_MATRIX_ACCESS_I_J(m4,i,j);
+
+  matrix4d initialTr;
+  initialTr = aJoint->initialPosition();
+  MAL_S4x4_MATRIX_ACCESS_I_J(initialTr,0,3) = 0.0;
+  MAL_S4x4_MATRIX_ACCESS_I_J(initialTr,1,3) = 0.0;
+  MAL_S4x4_MATRIX_ACCESS_I_J(initialTr,2,3) = 0.0;
+
+  matrix4d invrot;
+  for(unsigned int i=0;i<3;i++)
+    for(unsigned int j=0;j<3;j++)
+      {
+	MAL_S4x4_MATRIX_ACCESS_I_J(invrot,i,j)=0.0;
+	for(unsigned int k=0;k<3;k++)
+	  MAL_S4x4_MATRIX_ACCESS_I_J(invrot,i,j)+=
+	    res(i,k) * MAL_S4x4_MATRIX_ACCESS_I_J(initialTr,j,k);
+      }
+  for(unsigned int i=0;i<3;i++)
+    for(unsigned int j=0;j<3;j++)
+      res(i,j) = MAL_S4x4_MATRIX_ACCESS_I_J(invrot,i,j);
+}
+
+static double now( void )
+{
+  struct timeval tv;
+  gettimeofday(&tv,0);
+  return tv.tv_sec*1e6 + tv.tv_usec;
+}
+
+int main(int argc, char * argv[])
+{
+  if (argc!=5)
+    {
+      cerr << "Usage:" << endl;
+      cerr << "./" << argv[0] << " DIR_OF_VRML_MODEL VRML_MODEL_FILENAME PATH_TO_SPECIFICITIES_FILE PATH_TO_LINK2JOINT_FILE " << endl;
+      return 1;
+    }
+  DynamicBench * dyn = new DynamicBench("tot");
+  try
+    {
+      dyn->setVrmlDirectory(argv[1]);
+      dyn->setXmlSpecificityFile(argv[3]);
+      dyn->setXmlRankFile(argv[4]);
+      dyn->setVrmlMainFile(argv[2]);
+
+      dyn->parseConfigFiles();
+    }
+  catch (ExceptionDynamic& e)
+    {
+      if ( !strcmp(e.what(), "Error while parsing." )) {
+	cout << "Could not locate the necessary files for this benchmark" << endl;
+	return 77;
+      }
+      else
+	// rethrow
+	throw e;
+    }
+
+  const unsigned int NBDOF = dyn->m_HDR->numberDof();
+  vectorN q(NBDOF);
+  for( unsigned int i=0;i<NBDOF;++i ) q(i) = 0.01*i;
+  dyn->m_HDR->currentConfiguration(q);
+  dyn->m_HDR->computeForwardKinematics();
+
+  const std::vector<CjrlJoint*> joints = dyn->m_HDR->jointVector();
+  const unsigned int NBJOINTS = joints.size();
+  std::vector<double> corrections( 9*NBJOINTS );
+  for( unsigned int j=0;j<NBJOINTS;++j )
+    DynamicBench::computeFrameCorrection( joints[j],&corrections[9*j] );
+
+  MatrixHomogeneous legacy,fused;
+  const unsigned int NB_CALLS = 10000;
+  double t0 = now();
+  for( unsigned int n=0;n<NB_CALLS;++n )
+    for( unsigned int j=0;j<NBJOINTS;++j )
+      legacyJointPosition( joints[j],legacy );
+  double t1 = now();
+  for( unsigned int n=0;n<NB_CALLS;++n )
+    for( unsigned int j=0;j<NBJOINTS;++j )
+      DynamicBench::composeJointPosition( joints[j]->currentTransformation(),
+					  &corrections[9*j],fused );
+  double t2 = now();
+
+  const double calls = double(NB_CALLS)*NBJOINTS;
+  cout << "Joint position, per call:" << endl
+       << "  legacy: " << 1e3*(t1-t0)/calls << " ns" << endl
+       << "  cached correction: " << 1e3*(t2-t1)/calls << " ns" << endl;
+
+  delete dyn;
+  return 0;
+}
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2010,
+ * François Bleibel,
+ * Olivier Stasse,
+ *
+ * CNRS/AIST
+ *
+ * This file is part of sot-dynamic.
+ * sot-dynamic is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ * sot-dynamic is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.  You should
+ * have received a copy of the GNU Lesser General Public License along
+ * with sot-dynamic.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- INCLUDES ------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+#include <sot-dynamic/dynamic.h>
+#include <dynamic-graph/signal.h>
+#include <dynamic-graph/signal-time-dependent.h>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <new>
+
+using namespace std;
+using namespace dynamicgraph;
+using namespace dynamicgraph::sot;
+
+/* Count every heap allocation done by the process, including the ones
+ * done inside the dynamic plugin, but in the calls to jrl-dynamics. */
+static unsigned long allocationCount = 0;
+static bool counting = true;
+
+void* operator new( std::size_t size )
+{
+  if( counting ) ++allocationCount;
+  void* ptr = std::malloc( size==0 ? 1 : size );
+  if( 0==ptr ) throw std::bad_alloc();
+  return ptr;
+}
+void* operator new[]( std::size_t size )
+{ return operator new( size ); }
+void operator delete( void* ptr ) throw() { std::free( ptr ); }
+void operator delete[]( void* ptr ) throw() { std::free( ptr ); }
+
+/* The allocations of jrl-dynamics are not ours to remove. */
+class DynamicCounted : public Dynamic
+{
+public:
+  DynamicCounted( const std::string& name ) : Dynamic(name) {}
+protected:
+  virtual void computeRobotKinematics( void )
+  {
+    counting = false;
+    Dynamic::computeRobotKinematics();
+    counting = true;
+  }
+  virtual void computeJointJacobian( CjrlJoint* joint )
+  {
+    counting = false;
+    Dynamic::computeJointJacobian( joint );
+    counting = true;
+  }
+};
+
+/* Joint inputs changing at each tick, written in place. */
+static ml::Vector& jointInput( const double offset,const double amplitude,
+			       const unsigned int nbDof,
+			       ml::Vector& res,int time )
+{
+  if( res.size()!=nbDof ) res.resize( nbDof );
+  for( unsigned int i=0;i<nbDof;++i )
+    res(i) = offset*i + amplitude*std::sin( 0.01*time+i );
+  return res;
+}
+
+int main(int argc, char * argv[])
+{
+  if (argc!=5)
+    {
+      cerr << "Usage:" << endl;
+      cerr << "./" << argv[0] << " DIR_OF_VRML_MODEL VRML_MODEL_FILENAME PATH_TO_SPECIFICITIES_FILE PATH_TO_LINK2JOINT_FILE " << endl;
+      return 1;
+    }
+  DynamicCounted * dyn = new DynamicCounted("tot");
+  try
+    {
+      dyn->setVrmlDirectory(argv[1]);
+      dyn->setXmlSpecificityFile(argv[3]);
+      dyn->setXmlRankFile(argv[4]);
+      dyn->setVrmlMainFile(argv[2]);
+
+      dyn->parseConfigFiles();
+    }
+  catch (ExceptionDynamic& e)
+    {
+      if ( !strcmp(e.what(), "Error while parsing." )) {
+	cout << "Could not locate the necessary files for this test" << endl;
+	return 77;
+      }
+      else
+	// rethrow
+	throw e;
+    }
+
+  const unsigned int NBDOF = dyn->m_HDR->numberDof();
+  ml::Vector ff(6);
+  for( unsigned int i=0;i<6;++i ) ff(i) = 0.2;
+
+  SignalTimeDependent<ml::Vector,int>
+    position( boost::bind(&jointInput,0.01,0.1,NBDOF,_1,_2),
+	      sotNOSIGNAL,"position" );
+  SignalTimeDependent<ml::Vector,int>
+    velocity( boost::bind(&jointInput,0.,0.1,NBDOF,_1,_2),
+	      sotNOSIGNAL,"velocity" );
+  SignalTimeDependent<ml::Vector,int>
+    acceleration( boost::bind(&jointInput,0.,-0.1,NBDOF,_1,_2),
+		  sotNOSIGNAL,"acceleration" );
+  Signal<ml::Vector,int> ffposition("ffposition");
+  Signal<ml::Vector,int> ffvelocity("ffvelocity");
+  Signal<ml::Vector,int> ffacceleration("ffacceleration");
+  ffposition.setConstant(ff);
+  ffvelocity.setConstant(ff);
+  ffacceleration.setConstant(ff);
+  dyn->jointPositionSIN.plug(&position);
+  dyn->jointVelocitySIN.plug(&velocity);
+  dyn->jointAccelerationSIN.plug(&acceleration);
+  dyn->freeFlyerPositionSIN.plug(&ffposition);
+  dyn->freeFlyerVelocitySIN.plug(&ffvelocity);
+  dyn->freeFlyerAccelerationSIN.plug(&ffacceleration);
+
+  /* Outputs of a control tick: an operational point, the inertia and
+   * the acceleration of a joint. */
+  CjrlJoint* hand = dyn->m_HDR->jointVector().back();
+  SignalTimeDependent<MatrixHomogeneous,int>& handPosition
+    = dyn->createPositionSignal( "hand",hand );
+  SignalTimeDependent<ml::Matrix,int>& handJacobian
+    = dyn->createJacobianSignal( "Jhand",hand );
+  SignalTimeDependent<ml::Vector,int>& handAcceleration
+    = dyn->createAccelerationSignal( "ahand",hand );
+
+  /* First tick sizes the buffers. */
+  int time = 0;
+  handPosition(time); handJacobian(time); handAcceleration(time);
+  dyn->inertiaSOUT(time);
+  ++time;
+
+  const unsigned int NB_TICKS = 2000;
+  const unsigned long before = allocationCount;
+  for( unsigned int i=0;i<NB_TICKS;++i,++time )
+    {
+      handPosition(time);
+      handJacobian(time);
+      dyn->inertiaSOUT(time);
+      handAcceleration(time);
+    }
+  const unsigned long allocations = allocationCount-before;
+
+  if( dyn->positionBuffer_(0)!=ff(0) )
+    {
+      cerr << "Free-flyer override not applied to staged position." << endl;
+      return 1;
+    }
+  if( allocations!=0 )
+    {
+      cerr << allocations << " heap allocations during " << NB_TICKS
+	   << " ticks, expected none." << endl;
+      return 1;
+    }
+
+  delete dyn;
+  return 0;
+}
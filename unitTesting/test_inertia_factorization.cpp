@@ -0,0 +1,106 @@
+/*
+ * Copyright 2010,
+ * François Bleibel,
+ * Olivier Stasse,
+ *
+ * CNRS/AIST
+ *
+ * This file is part of sot-dynamic.
+ * sot-dynamic is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ * sot-dynamic is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.  You should
+ * have received a copy of the GNU Lesser General Public License along
+ * with sot-dynamic.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* -------------------------------------------------------------------------- */
+/* --- INCLUDES ------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+#include <sot-dynamic/inertia-factorization.h>
+#include <iostream>
+#include <cmath>
+
+using namespace std;
+using namespace dynamicgraph::sot;
+
+/* Build M = L'.D.L on a branched tree whose dofs are shuffled in the
+ * configuration, and compare the factorization and the solvers with the
+ * dense products. */
+int main (int , char** )
+{
+  const unsigned int NBDOFS = 10;
+  const int PARENTS[NBDOFS] = { -1,0,1,2,3,2,5,6,1,8 };
+  const unsigned int ORDER[NBDOFS] = { 3,0,7,1,9,4,2,8,5,6 };
+  std::vector<int> parents( PARENTS,PARENTS+NBDOFS );
+  std::vector<unsigned int> order( ORDER,ORDER+NBDOFS );
+
+  ml::Matrix L; L.resize(NBDOFS,NBDOFS);
+  ml::Vector D(NBDOFS);
+  for( unsigned int k=0;k<NBDOFS;++k )
+    {
+      L(k,k) = 1.; D(k) = 1.+0.5*k;
+      for( int j=parents[k];j>=0;j=parents[j] )
+	L(k,j) = std::cos( double(k*5+j) );
+    }
+  ml::Matrix M; M.resize(NBDOFS,NBDOFS);
+  for( unsigned int a=0;a<NBDOFS;++a )
+    for( unsigned int b=0;b<NBDOFS;++b )
+      for( unsigned int k=0;k<NBDOFS;++k )
+	M(order[a],order[b]) += L(k,a)*D(k)*L(k,b);
+
+  InertiaFactorization F;
+  F.setStructure( parents,order );
+  if(! F.factorize( M ) )
+    {
+      cerr << "Factorization failed." << endl;
+      return 1;
+    }
+
+  double err = 0.;
+  for( unsigned int k=0;k<NBDOFS;++k )
+    err += std::fabs( F.D()[k]-D(k) );
+
+  ml::Vector x(NBDOFS),Mx,Minvx;
+  for( unsigned int i=0;i<NBDOFS;++i ) x(i) = std::sin( double(i) );
+  F.multiply( x,Mx );
+  F.solve( x,Minvx );
+  for( unsigned int i=0;i<NBDOFS;++i )
+    {
+      double Mx_ref = 0.,MMinvx = 0.;
+      for( unsigned int j=0;j<NBDOFS;++j )
+	{
+	  Mx_ref += M(i,j)*x(j);
+	  MMinvx += M(i,j)*Minvx(j);
+	}
+      err += std::fabs( Mx(i)-Mx_ref ) + std::fabs( MMinvx-x(i) );
+    }
+
+  ml::Matrix J; J.resize(3,NBDOFS);
+  for( unsigned int r=0;r<3;++r )
+    for( unsigned int c=0;c<NBDOFS;++c )
+      J(r,c) = std::cos( double(r*11+c) );
+  ml::Matrix Jt,MinvJt,P;
+  J.transpose( Jt );
+  F.solve( Jt,MinvJt );
+  F.projectedInverse( J,P );
+  for( unsigned int r=0;r<3;++r )
+    for( unsigned int c=0;c<3;++c )
+      {
+	double P_ref = 0.;
+	for( unsigned int k=0;k<NBDOFS;++k ) P_ref += J(r,k)*MinvJt(k,c);
+	err += std::fabs( P(r,c)-P_ref );
+      }
+
+  if( err>1e-9 )
+    {
+      cerr << "Sparse factorization differs from dense products: " << err << endl;
+      return 1;
+    }
+  return 0;
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2010,
+ * François Bleibel,
+ * Olivier Stasse,
+ *
+ * CNRS/AIST
+ *
+ * This file is part of sot-dynamic.
+ * sot-dynamic is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ * sot-dynamic is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.  You should
+ * have received a copy of the GNU Lesser General Public License along
+ * with sot-dynamic.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Check of the inertia matrix computed by MatrixInertia against the one
+ * of jrl-dynamics, on the sample model, and of the whole matrix against
+ * the kinetic energy of the bodies. The timings are in
+ * bench_matrix_inertia. */
+
+#include <string>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <jrl/mal/matrixabstractlayer.hh>
+#include "jrl/dynamics/dynamicsfactory.hh"
+#include <sot-dynamic/matrix-inertia.h>
+using namespace std;
+using namespace dynamicgraph::sot;
+
+/* Rotation and translation of the joint frames at configuration q. */
+static void jointFrames( CjrlHumanoidDynamicRobot& robot,const vectorN& q,
+			 std::vector<matrix4d>& frames )
+{
+  robot.currentConfiguration( q );
+  robot.computeForwardKinematics();
+  const std::vector<CjrlJoint*> joints = robot.jointVector();
+  frames.resize( joints.size() );
+  for( unsigned int i=0;i<joints.size();++i )
+    frames[i] = joints[i]->currentTransformation();
+}
+
+/* Kinetic energy of the bodies at configuration q and velocity dq, the
+ * velocities of the joint frames by central differences. */
+static double kineticEnergy( CjrlHumanoidDynamicRobot& robot,
+			     const vectorN& q,const vectorN& dq )
+{
+  const double h = 1e-6;
+  std::vector<matrix4d> M,Mp,Mm;
+  jointFrames( robot,q+h*dq,Mp );
+  jointFrames( robot,q-h*dq,Mm );
+  jointFrames( robot,q,M );
+
+  const std::vector<CjrlJoint*> joints = robot.jointVector();
+  double energy = 0.;
+  for( unsigned int i=0;i<joints.size();++i )
+    {
+      const CjrlBody* body = joints[i]->linkedBody();
+      if( 0==body ) continue;
+      /* R'.dR/dt is the skew matrix of the angular velocity, R'.dp/dt the
+       * linear velocity, both in the joint frame. */
+      double W[3][3],v[3];
+      for( unsigned int r=0;r<3;++r )
+	{
+	  v[r] = 0.;
+	  for( unsigned int c=0;c<3;++c )
+	    {
+	      W[r][c] = 0.;
+	      for( unsigned int k=0;k<3;++k )
+		W[r][c] += MAL_S4x4_MATRIX_ACCESS_I_J( M[i],k,r )
+		  * ( MAL_S4x4_MATRIX_ACCESS_I_J( Mp[i],k,c )
+		      - MAL_S4x4_MATRIX_ACCESS_I_J( Mm[i],k,c ) )/(2*h);
+	      v[r] += MAL_S4x4_MATRIX_ACCESS_I_J( M[i],c,r )
+		* ( MAL_S4x4_MATRIX_ACCESS_I_J( Mp[i],c,3 )
+		    - MAL_S4x4_MATRIX_ACCESS_I_J( Mm[i],c,3 ) )/(2*h);
+	    }
+	}
+      const double w[3] = { W[2][1],W[0][2],W[1][0] };
+      const vector3d& com = body->localCenterOfMass();
+      const matrix3d& I = body->inertiaMatrix();
+      /* Velocity of the center of mass. */
+      const double vc[3] = { v[0] + w[1]*com[2] - w[2]*com[1],
+			     v[1] + w[2]*com[0] - w[0]*com[2],
+			     v[2] + w[0]*com[1] - w[1]*com[0] };
+      double rotation = 0.;
+      for( unsigned int r=0;r<3;++r )
+	for( unsigned int c=0;c<3;++c )
+	  rotation += w[r]*MAL_S3x3_MATRIX_ACCESS_I_J( I,r,c )*w[c];
+      energy += 0.5*body->mass()*( vc[0]*vc[0]+vc[1]*vc[1]+vc[2]*vc[2] )
+	+ 0.5*rotation;
+    }
+  return energy;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc!=5)
+    {
+      cerr << "Usage:" << endl;
+      cerr << "./" << argv[0] << " DIR_OF_VRML_MODEL VRML_MODEL_FILENAME PATH_TO_SPECIFICITIES_FILE PATH_TO_LINK2JOINT_FILE " << endl;
+      return 77;
+    }
+
+  dynamicsJRLJapan::ObjectFactory aRobotDynamicsObjectConstructor;
+  CjrlHumanoidDynamicRobot * aHDR = aRobotDynamicsObjectConstructor.createHumanoidDynamicRobot();
+  string RobotFileName = string(argv[1]) + argv[2];
+  try
+    {
+      dynamicsJRLJapan::parseOpenHRPVRMLFile(*aHDR,RobotFileName,argv[4],argv[3]);
+    }
+  catch (...) {}
+  if( aHDR->numberDof()==0 )
+    {
+      cout << "Could not locate the necessary files for this test" << endl;
+      return 77;
+    }
+
+  /* Arbitrary configuration, away from the singularities of the zero one. */
+  const int NbOfDofs = aHDR->numberDof();
+  MAL_VECTOR_DIM(aCurrentConf,double,NbOfDofs);
+  for( int i=0;i<NbOfDofs;++i )
+    aCurrentConf[i] = ( i<6 ) ? 0.0 : 0.3*sin( 1.+i );
+  aHDR->currentConfiguration(aCurrentConf);
+  aHDR->computeForwardKinematics();
+
+  MatrixInertia matrixInertia( aHDR );
+
+  aHDR->computeInertiaMatrix();
+  matrixInertia.update();
+  matrixInertia.computeInertiaMatrix();
+
+  /* Compare the joint-space block to jrl-dynamics; the whole matrix,
+   * free flyer included, is checked against the kinetic energy below. */
+  const matrixNxP & Hjrl = aHDR->inertiaMatrix();
+  const ml::Matrix & Hsot = matrixInertia.getInertiaMatrix();
+  double maxError = 0.;
+  for( int i=6;i<NbOfDofs;++i )
+    for( int j=6;j<NbOfDofs;++j )
+      maxError = std::max( maxError,fabs( Hjrl(i,j)-Hsot(i,j) ) );
+
+  cout << "Max difference on the joint-space block: " << maxError << endl;
+
+  /* 1/2 dq'.H.dq is the kinetic energy, free flyer included: its
+   * roll-pitch-yaw velocity is the angular velocity at the zero
+   * orientation of the configuration above. */
+  double energyError = 0.,energyScale = 1.;
+  for( unsigned int it=0;it<10;++it )
+    {
+      vectorN dq( NbOfDofs );
+      for( int i=0;i<NbOfDofs;++i ) dq(i) = 0.5*cos( 1.+i+3.*it );
+      double energy = 0.;
+      for( int i=0;i<NbOfDofs;++i )
+	for( int j=0;j<NbOfDofs;++j )
+	  energy += 0.5*dq(i)*Hsot(i,j)*dq(j);
+      const double reference = kineticEnergy( *aHDR,aCurrentConf,dq );
+      energyError = std::max( energyError,fabs( energy-reference ) );
+      energyScale = std::max( energyScale,fabs( reference ) );
+    }
+  cout << "Relative error on the kinetic energy: "
+       << energyError/energyScale << endl;
+
+  /* The dimension and the packed layouts. */
+  const unsigned int n = matrixInertia.getDimension();
+  std::vector<double> packed( MatrixInertia::bufferSize( n,MatrixInertia::PACKED_UPPER ) );
+  std::vector<double> lower( n*n );
+  matrixInertia.computeInertiaMatrix( &packed[0],MatrixInertia::PACKED_UPPER );
+  matrixInertia.computeInertiaMatrix( &lower[0],MatrixInertia::LOWER_COLUMN_MAJOR );
+  double layoutError = 0.;
+  for( unsigned int i=0;i<n;++i )
+    for( unsigned int j=i;j<n;++j )
+      {
+	layoutError = std::max( layoutError,fabs( packed[i+(j*(j+1))/2]-Hsot(i,j) ) );
+	layoutError = std::max( layoutError,fabs( lower[j+i*n]-Hsot(i,j) ) );
+      }
+
+  delete aHDR;
+  if( (matrixInertia.getDoF()!=(size_t)NbOfDofs)||(n!=(unsigned int)NbOfDofs) )
+    {
+      cerr << "Wrong number of dofs." << endl;
+      return 1;
+    }
+  if( maxError>1e-8 )
+    {
+      cerr << "Joint-space block differs from jrl-dynamics." << endl;
+      return 1;
+    }
+  if( energyError/energyScale>1e-6 )
+    {
+      cerr << "Inertia matrix inconsistent with the kinetic energy." << endl;
+      return 1;
+    }
+  if( layoutError>1e-12 )
+    {
+      cerr << "Packed layouts differ from the dense matrix." << endl;
+      return 1;
+    }
+  return 0;
+}
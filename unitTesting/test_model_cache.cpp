@@ -0,0 +1,195 @@
+/*
+ * Copyright 2010,
+ * François Bleibel,
+ * Olivier Stasse,
+ *
+ * CNRS/AIST
+ *
+ * This file is part of sot-dynamic.
+ * sot-dynamic is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ * sot-dynamic is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.  You should
+ * have received a copy of the GNU Lesser General Public License along
+ * with sot-dynamic.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- INCLUDES ------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+#include <sot-dynamic/dynamic.h>
+#include "model-cache.h"
+#include <boost/filesystem.hpp>
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <map>
+
+using namespace std;
+using namespace dynamicgraph::sot;
+
+static Dynamic* parse( const std::string& name,char * argv[],
+		       const std::string& cacheDirectory )
+{
+  Dynamic * dyn = new Dynamic(name);
+  dyn->setModelCacheDirectory(cacheDirectory);
+  dyn->setVrmlDirectory(argv[1]);
+  dyn->setXmlSpecificityFile(argv[3]);
+  dyn->setXmlRankFile(argv[4]);
+  dyn->setVrmlMainFile(argv[2]);
+  dyn->parseConfigFiles();
+  return dyn;
+}
+
+static std::string jointName( const CjrlJoint* joint )
+{
+  return ( 0==joint ) ? std::string("(none)") : joint->getName();
+}
+
+/* Compare the joints, by name, and the special joints of two robots. */
+static bool sameModel( CjrlHumanoidDynamicRobot& parsed,
+		       CjrlHumanoidDynamicRobot& replayed )
+{
+  if( parsed.numberDof()!=replayed.numberDof() )
+    {
+      cerr << "Number of dofs differs." << endl;
+      return false;
+    }
+  const std::vector<CjrlJoint*> parsedJoints = parsed.jointVector();
+  const std::vector<CjrlJoint*> replayedJoints = replayed.jointVector();
+  if( parsedJoints.size()!=replayedJoints.size() )
+    {
+      cerr << "Number of joints differs." << endl;
+      return false;
+    }
+  std::map<std::string,CjrlJoint*> byName;
+  for( unsigned int i=0;i<replayedJoints.size();++i )
+    byName[ replayedJoints[i]->getName() ] = replayedJoints[i];
+
+  for( unsigned int i=0;i<parsedJoints.size();++i )
+    {
+      const CjrlJoint& a = *parsedJoints[i];
+      if( byName.count( a.getName() )==0 )
+	{
+	  cerr << "Joint " << a.getName() << " not replayed." << endl;
+	  return false;
+	}
+      const CjrlJoint& b = *byName[ a.getName() ];
+      bool same = ( a.rankInConfiguration()==b.rankInConfiguration() )
+	&& ( a.numberDof()==b.numberDof() )
+	&& ( jointName( a.parentJoint() )==jointName( b.parentJoint() ) );
+      for( unsigned int k=0;same&&(k<a.numberDof());++k )
+	same = ( a.lowerBound(k)==b.lowerBound(k) )
+	  && ( a.upperBound(k)==b.upperBound(k) )
+	  && ( a.lowerVelocityBound(k)==b.lowerVelocityBound(k) )
+	  && ( a.upperVelocityBound(k)==b.upperVelocityBound(k) )
+	  && ( a.lowerTorqueBound(k)==b.lowerTorqueBound(k) )
+	  && ( a.upperTorqueBound(k)==b.upperTorqueBound(k) );
+      const CjrlBody* bodyA = a.linkedBody();
+      const CjrlBody* bodyB = b.linkedBody();
+      if( same&&( (0==bodyA)!=(0==bodyB) ) ) same = false;
+      if( same&&(0!=bodyA) )
+	{
+	  same = ( bodyA->mass()==bodyB->mass() );
+	  for( unsigned int r=0;same&&(r<3);++r )
+	    {
+	      same = ( bodyA->localCenterOfMass()[r]==bodyB->localCenterOfMass()[r] );
+	      for( unsigned int c=0;same&&(c<3);++c )
+		same = ( bodyA->inertiaMatrix()(r,c)==bodyB->inertiaMatrix()(r,c) );
+	    }
+	}
+      if(! same )
+	{
+	  cerr << "Joint " << a.getName() << " differs." << endl;
+	  return false;
+	}
+    }
+
+  const bool sameSpecials
+    = ( jointName( parsed.waist() )==jointName( replayed.waist() ) )
+    && ( jointName( parsed.chest() )==jointName( replayed.chest() ) )
+    && ( jointName( parsed.leftWrist() )==jointName( replayed.leftWrist() ) )
+    && ( jointName( parsed.rightWrist() )==jointName( replayed.rightWrist() ) )
+    && ( jointName( parsed.leftAnkle() )==jointName( replayed.leftAnkle() ) )
+    && ( jointName( parsed.rightAnkle() )==jointName( replayed.rightAnkle() ) )
+    && ( jointName( parsed.gazeJoint() )==jointName( replayed.gazeJoint() ) );
+  if(! sameSpecials )
+    {
+      cerr << "Specificities differ." << endl;
+      return false;
+    }
+  return true;
+}
+
+int main(int argc, char * argv[])
+{
+  if (argc!=5)
+    {
+      cerr << "Usage:" << endl;
+      cerr << "./" << argv[0] << " DIR_OF_VRML_MODEL VRML_MODEL_FILENAME PATH_TO_SPECIFICITIES_FILE PATH_TO_LINK2JOINT_FILE " << endl;
+      return 1;
+    }
+
+  char directory[] = "/tmp/sot-dynamic-cache-XXXXXX";
+  if( 0==mkdtemp( directory ) )
+    {
+      cerr << "Cannot create a temporary directory." << endl;
+      return 1;
+    }
+
+  /* The first entity parses the files and writes the cache, the second
+   * one replays it. */
+  Dynamic * parsed = 0;
+  Dynamic * replayed = 0;
+  try
+    {
+      parsed = parse( "parsed",argv,directory );
+      replayed = parse( "replayed",argv,directory );
+    }
+  catch (ExceptionDynamic& e)
+    {
+      boost::filesystem::remove_all( directory );
+      if ( !strcmp(e.what(), "Error while parsing." )) {
+	cout << "Could not locate the necessary files for this test" << endl;
+	return 77;
+      }
+      else
+	// rethrow
+	throw e;
+    }
+
+  const bool written
+    = boost::filesystem::directory_iterator( directory )
+    != boost::filesystem::directory_iterator();
+  boost::filesystem::remove_all( directory );
+  if(! written )
+    {
+      cerr << "No cache file written." << endl;
+      return 1;
+    }
+  if(! sameModel( *parsed->m_HDR,*replayed->m_HDR ) ) return 1;
+
+  /* Capturing a model leaves the robot at its configuration. */
+  CjrlHumanoidDynamicRobot& robot = *parsed->m_HDR;
+  vectorN q( robot.numberDof() );
+  for( unsigned int i=0;i<q.size();++i ) q(i) = 0.01*i;
+  robot.currentConfiguration( q );
+  robot.computeForwardKinematics();
+  ModelDescription model;
+  model.capture( robot );
+  const vectorN& current = robot.currentConfiguration();
+  for( unsigned int i=0;i<q.size();++i )
+    if( current(i)!=q(i) )
+      {
+	cerr << "Configuration not restored by the capture." << endl;
+	return 1;
+      }
+
+  delete parsed;
+  delete replayed;
+  return 0;
+}
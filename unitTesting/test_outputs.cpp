@@ -0,0 +1,334 @@
+/*
+ * Copyright 2010,
+ * François Bleibel,
+ * Olivier Stasse,
+ *
+ * CNRS/AIST
+ *
+ * This file is part of sot-dynamic.
+ * sot-dynamic is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ * sot-dynamic is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.  You should
+ * have received a copy of the GNU Lesser General Public License along
+ * with sot-dynamic.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- INCLUDES ------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+#include <sot-dynamic/dynamic.h>
+#include <dynamic-graph/signal.h>
+#include <iostream>
+#include <cstring>
+#include <cmath>
+
+using namespace std;
+using namespace dynamicgraph;
+using namespace dynamicgraph::sot;
+
+/* Compare the outputs computed by sot-dynamic on the kinematic tree with
+ * the ones of jrl-dynamics, on the parsed model, at several
+ * configurations with a moving free flyer. */
+
+static const double TOLERANCE = 1e-9;
+
+static double maxDiff( const ml::Vector& a,const vector3d& b )
+{
+  double err = 0.;
+  for( unsigned int i=0;i<3;++i )
+    err = std::max( err,std::fabs( a(i)-b[i] ) );
+  return err;
+}
+
+static double maxDiff( const ml::Matrix& a,const matrixNxP& b )
+{
+  if( (a.nbRows()!=b.size1())||(a.nbCols()!=b.size2()) ) return HUGE_VAL;
+  double err = 0.;
+  for( unsigned int i=0;i<a.nbRows();++i )
+    for( unsigned int j=0;j<a.nbCols();++j )
+      err = std::max( err,std::fabs( a(i,j)-b(i,j) ) );
+  return err;
+}
+
+static bool report( const char* output,const int time,const double err,
+		    const double tolerance = TOLERANCE )
+{
+  if( err<=tolerance ) return true;
+  cerr << output << " differs from the reference by " << err
+       << " at time " << time << "." << endl;
+  return false;
+}
+
+/* com and Jcom against positionCenterOfMass and getJacobianCenterOfMass. */
+static bool checkCom( Dynamic& dyn,const int time )
+{
+  const ml::Vector& com = dyn.comSOUT(time);
+  const ml::Matrix& Jcom = dyn.JcomSOUT(time);
+  dyn.newtonEulerSINTERN(time);
+
+  CjrlHumanoidDynamicRobot& robot = *dyn.m_HDR;
+  matrixNxP J( 3,robot.numberDof() );
+  robot.getJacobianCenterOfMass( *robot.rootJoint(),J );
+  return report( "com",time,maxDiff( com,robot.positionCenterOfMass() ) )
+    && report( "Jcom",time,maxDiff( Jcom,J ) );
+}
+
+/* Linear part of Ag.dq against the mass times the velocity of the center
+ * of mass of jrl-dynamics. */
+static bool checkCentroidalMomentum( Dynamic& dyn,const ml::Vector& dq,
+				     const int time )
+{
+  const ml::Matrix& Ag = dyn.AgSOUT(time);
+  dyn.newtonEulerSINTERN(time);
+
+  CjrlHumanoidDynamicRobot& robot = *dyn.m_HDR;
+  const unsigned int NBDOF = robot.numberDof();
+  matrixNxP J( 3,NBDOF );
+  robot.getJacobianCenterOfMass( *robot.rootJoint(),J );
+  if( (Ag.nbRows()!=6)||(Ag.nbCols()!=NBDOF) )
+    return report( "Ag",time,HUGE_VAL );
+  double err = 0.;
+  for( unsigned int r=0;r<3;++r )
+    {
+      double h = 0.,mdcom = 0.;
+      for( unsigned int j=0;j<NBDOF;++j )
+	{
+	  h += Ag(r,j)*dq(j);
+	  mdcom += robot.mass()*J(r,j)*dq(j);
+	}
+      err = std::max( err,std::fabs( h-mdcom ) );
+    }
+  return report( "Ag.dq",time,err );
+}
+
+/* Torques of the tree against the Newton-Euler torques of jrl-dynamics
+ * (dynamicDrift), on the actuated dofs. The free-flyer rows of jrl are the
+ * wrench at the root joint in its own convention: they are only compared
+ * between the two tree outputs. */
+static double maxDiff( const ml::Vector& a,const ml::Vector& b,
+		       const unsigned int first )
+{
+  if( a.size()!=b.size() ) return HUGE_VAL;
+  double err = 0.;
+  for( unsigned int i=first;i<a.size();++i )
+    err = std::max( err,std::fabs( a(i)-b(i) ) );
+  return err;
+}
+
+/* At zero acceleration. */
+static bool checkNonlinearEffects( Dynamic& dyn,const int time )
+{
+  const ml::Vector& nle = dyn.nonlinearEffectsSOUT(time);
+  const ml::Vector& drift = dyn.dynamicDriftSOUT(time);
+  return report( "nonlinearEffects",time,maxDiff( nle,drift,6 ) );
+}
+
+/* At zero velocity and acceleration. */
+static bool checkGravityTorque( Dynamic& dyn,const int time )
+{
+  const ml::Vector& g = dyn.gravityTorqueSOUT(time);
+  const ml::Vector& nle = dyn.nonlinearEffectsSOUT(time);
+  const ml::Vector& drift = dyn.dynamicDriftSOUT(time);
+  return report( "gravityTorque",time,maxDiff( g,drift,6 ) )
+    && report( "gravityTorque (free flyer)",time,maxDiff( g,nle,0 ) );
+}
+
+/* forwardDynamics against inertia^-1.(tau - nonlinearEffects): the residual
+ * inertia.ddq + nonlinearEffects - tau vanishes. The inertia comes from
+ * jrl-dynamics, the tolerance is relative to the torques. */
+static bool checkForwardDynamics( Dynamic& dyn,const ml::Vector& tau,
+				  const int time )
+{
+  const ml::Vector& ddq = dyn.forwardDynamicsSOUT(time);
+  const ml::Vector& nle = dyn.nonlinearEffectsSOUT(time);
+  const ml::Matrix& A = dyn.inertiaSOUT(time);
+  const unsigned int NBDOF = tau.size();
+  if( (ddq.size()!=NBDOF)||(nle.size()!=NBDOF)
+      ||(A.nbRows()!=NBDOF)||(A.nbCols()!=NBDOF) )
+    return report( "forwardDynamics",time,HUGE_VAL );
+  double err = 0.,scale = 1.;
+  for( unsigned int i=0;i<NBDOF;++i )
+    {
+      double r = nle(i)-tau(i);
+      for( unsigned int j=0;j<NBDOF;++j ) r += A(i,j)*ddq(j);
+      err = std::max( err,std::fabs(r) );
+      scale = std::max( scale,std::fabs(tau(i)) );
+    }
+  return report( "forwardDynamics",time,err/scale,1e-8 );
+}
+
+/* Velocity of the joint origin and angular velocity in the world frame,
+ * from the end-effector jacobian and the joint position. */
+static void worldVelocity( const ml::Matrix& J,const MatrixHomogeneous& M,
+			   const ml::Vector& dq,double v[6] )
+{
+  double local[6];
+  for( unsigned int r=0;r<6;++r )
+    {
+      local[r] = 0.;
+      for( unsigned int j=0;j<dq.size();++j ) local[r] += J(r,j)*dq(j);
+    }
+  for( unsigned int r=0;r<3;++r )
+    {
+      v[r] = v[r+3] = 0.;
+      for( unsigned int k=0;k<3;++k )
+	{
+	  v[r] += M(r,k)*local[k];
+	  v[r+3] += M(r,k)*local[k+3];
+	}
+    }
+}
+
+/* dJv and dJcomv against the central difference
+ * (J(q+h.dq) - J(q-h.dq))/2h.dq. The drift of the end-effector jacobian
+ * is the derivative of the world velocity, expressed in the joint frame.
+ * The free flyer does not move: its velocity is not the derivative of its
+ * roll-pitch-yaw coordinates. Evaluates at time+1 (the drifts) to
+ * time+3. */
+static bool checkDrifts( Dynamic& dyn,
+			 SignalTimeDependent<ml::Matrix,int>& J,
+			 SignalTimeDependent<MatrixHomogeneous,int>& M,
+			 SignalTimeDependent<ml::Vector,int>& dJv,
+			 Signal<ml::Vector,int>& position,
+			 Signal<ml::Vector,int>& velocity,
+			 const ml::Vector& q,const ml::Vector& dq,int& time )
+{
+  const double h = 1e-5;
+  const unsigned int NBDOF = q.size();
+  ml::Vector dqa = dq;
+  for( unsigned int i=0;i<6;++i ) dqa(i) = 0.;
+  velocity.setConstant(dqa);
+  const ml::Vector drift = dJv(++time);
+  const ml::Vector comDrift = dyn.dJcomvSOUT(time);
+  const MatrixHomogeneous R = M(time);
+
+  double v[2][6],vcom[2][3];
+  ml::Vector qh(NBDOF);
+  for( unsigned int s=0;s<2;++s )
+    {
+      const double sign = ( 0==s ) ? 1. : -1.;
+      for( unsigned int i=0;i<NBDOF;++i ) qh(i) = q(i)+sign*h*dqa(i);
+      position.setConstant(qh);
+      ++time;
+      worldVelocity( J(time),M(time),dqa,v[s] );
+      const ml::Matrix& Jcom = dyn.JcomSOUT(time);
+      for( unsigned int r=0;r<3;++r )
+	{
+	  vcom[s][r] = 0.;
+	  for( unsigned int j=0;j<NBDOF;++j ) vcom[s][r] += Jcom(r,j)*dqa(j);
+	}
+    }
+  position.setConstant(q);
+  velocity.setConstant(dq);
+
+  double err = 0.,comErr = 0.;
+  for( unsigned int r=0;r<3;++r )
+    {
+      double a = 0.,dw = 0.;
+      for( unsigned int k=0;k<3;++k )
+	{
+	  a += R(k,r)*( v[0][k]-v[1][k] )/(2*h);
+	  dw += R(k,r)*( v[0][k+3]-v[1][k+3] )/(2*h);
+	}
+      err = std::max( err,std::max( std::fabs( a-drift(r) ),
+				    std::fabs( dw-drift(r+3) ) ) );
+      comErr = std::max( comErr,
+			 std::fabs( ( vcom[0][r]-vcom[1][r] )/(2*h)-comDrift(r) ) );
+    }
+  return report( "dJv",time,err,1e-6 )
+    && report( "dJcomv",time,comErr,1e-6 );
+}
+
+int main(int argc, char * argv[])
+{
+  if (argc!=5)
+    {
+      cerr << "Usage:" << endl;
+      cerr << "./" << argv[0] << " DIR_OF_VRML_MODEL VRML_MODEL_FILENAME PATH_TO_SPECIFICITIES_FILE PATH_TO_LINK2JOINT_FILE " << endl;
+      return 1;
+    }
+  Dynamic * dyn = new Dynamic("tot");
+  try
+    {
+      dyn->setVrmlDirectory(argv[1]);
+      dyn->setXmlSpecificityFile(argv[3]);
+      dyn->setXmlRankFile(argv[4]);
+      dyn->setVrmlMainFile(argv[2]);
+
+      dyn->parseConfigFiles();
+    }
+  catch (ExceptionDynamic& e)
+    {
+      if ( !strcmp(e.what(), "Error while parsing." )) {
+	cout << "Could not locate the necessary files for this test" << endl;
+	return 77;
+      }
+      else
+	// rethrow
+	throw e;
+    }
+  dyn->comActivation(true);
+
+  const unsigned int NBDOF = dyn->m_HDR->numberDof();
+  ml::Vector q(NBDOF),dq(NBDOF),ddq(NBDOF),tau(NBDOF);
+  Signal<ml::Vector,int> position("position");
+  Signal<ml::Vector,int> velocity("velocity");
+  Signal<ml::Vector,int> acceleration("acceleration");
+  Signal<ml::Vector,int> torque("torque");
+  dyn->jointPositionSIN.plug(&position);
+  dyn->jointVelocitySIN.plug(&velocity);
+  dyn->jointAccelerationSIN.plug(&acceleration);
+  dyn->jointTorqueSIN.plug(&torque);
+
+  CjrlJoint* endJoint = dyn->m_HDR->jointVector().back();
+  SignalTimeDependent<ml::Matrix,int>& Jend
+    = dyn->createEndeffJacobianSignal( "Jend",endJoint );
+  SignalTimeDependent<MatrixHomogeneous,int>& Mend
+    = dyn->createPositionSignal( "end",endJoint );
+  SignalTimeDependent<ml::Vector,int>& dJvEnd
+    = dyn->createJacobianDriftSignal( "dJvend",endJoint );
+
+  /* The 6 first coordinates are the free flyer: translation and
+   * roll-pitch-yaw. */
+  const unsigned int NB_CONFIGURATIONS = 4;
+  ml::Vector zero(NBDOF); zero.fill(0.);
+  int time = 0;
+  for( unsigned int c=0;c<NB_CONFIGURATIONS;++c )
+    {
+      for( unsigned int i=0;i<NBDOF;++i )
+	{
+	  q(i) = 0.3*std::sin( 1.+i+3.*c );
+	  dq(i) = 0.5*std::cos( 2.+i+c );
+	  ddq(i) = 0.4*std::sin( 3.+2.*i+c );
+	  tau(i) = 20.*std::cos( 4.+3.*i+c );
+	}
+      position.setConstant(q);
+      velocity.setConstant(dq);
+      acceleration.setConstant(ddq);
+      torque.setConstant(tau);
+
+      ++time;
+      if(! checkCom( *dyn,time ) ) return 1;
+      if(! checkCentroidalMomentum( *dyn,dq,time ) ) return 1;
+      if(! checkDrifts( *dyn,Jend,Mend,dJvEnd,position,velocity,
+			 q,dq,time ) )
+	return 1;
+
+      acceleration.setConstant(zero);
+      ++time;
+      if(! checkNonlinearEffects( *dyn,time ) ) return 1;
+      if(! checkForwardDynamics( *dyn,tau,time ) ) return 1;
+
+      velocity.setConstant(zero);
+      ++time;
+      if(! checkGravityTorque( *dyn,time ) ) return 1;
+    }
+
+  delete dyn;
+  return 0;
+}
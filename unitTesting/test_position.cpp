@@ -0,0 +1,181 @@
+/*
+ * Copyright 2010,
+ * François Bleibel,
+ * Olivier Stasse,
+ *
+ * CNRS/AIST
+ *
+ * This file is part of sot-dynamic.
+ * sot-dynamic is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ * sot-dynamic is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.  You should
+ * have received a copy of the GNU Lesser General Public License along
+ * with sot-dynamic.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* -------------------------------------------------------------------------- */
+/* --- INCLUDES ------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+#include <sot-dynamic/dynamic.h>
+#include <dynamic-graph/signal.h>
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cmath>
+
+using namespace std;
+using namespace dynamicgraph;
+using namespace dynamicgraph::sot;
+
+/* Give access to the protected position kernels. */
+class DynamicAccess : public Dynamic
+{
+public:
+  DynamicAccess( const std::string& name ) : Dynamic(name) {}
+  using Dynamic::computeFrameCorrection;
+  using Dynamic::composeJointPosition;
+};
+
+/* Position computation as done before the correction was cached: element
+ * copy of the transform, then correction derived from the initial
+ * position at each call. */
+static void legacyJointPosition( CjrlJoint* aJoint,MatrixHomogeneous& res )
+{
+  const matrix4d & m4 = aJoint->currentTransformation();
+  res.resize(4,4);
+  for( int i=0;i<4;++i )
+    for( int j=0;j<4;++j )
+      res(i,j) = MAL_S4x4_MATRIX_ACCESS_I_J(m4,i,j);
+
+  matrix4d initialTr;
+  initialTr = aJoint->initialPosition();
+  MAL_S4x4_MATRIX_ACCESS_I_J(initialTr,0,3) = 0.0;
+  MAL_S4x4_MATRIX_ACCESS_I_J(initialTr,1,3) = 0.0;
+  MAL_S4x4_MATRIX_ACCESS_I_J(initialTr,2,3) = 0.0;
+
+  matrix4d invrot;
+  for(unsigned int i=0;i<3;i++)
+    for(unsigned int j=0;j<3;j++)
+      {
+	MAL_S4x4_MATRIX_ACCESS_I_J(invrot,i,j)=0.0;
+	for(unsigned int k=0;k<3;k++)
+	  MAL_S4x4_MATRIX_ACCESS_I_J(invrot,i,j)+=
+	    res(i,k) * MAL_S4x4_MATRIX_ACCESS_I_J(initialTr,j,k);
+      }
+  for(unsigned int i=0;i<3;i++)
+    for(unsigned int j=0;j<3;j++)
+      res(i,j) = MAL_S4x4_MATRIX_ACCESS_I_J(invrot,i,j);
+}
+
+int main(int argc, char * argv[])
+{
+  if (argc!=5)
+    {
+      cerr << "Usage:" << endl;
+      cerr << "./" << argv[0] << " DIR_OF_VRML_MODEL VRML_MODEL_FILENAME PATH_TO_SPECIFICITIES_FILE PATH_TO_LINK2JOINT_FILE " << endl;
+      return 1;
+    }
+  DynamicAccess * dyn = new DynamicAccess("tot");
+  try
+    {
+      dyn->setVrmlDirectory(argv[1]);
+      dyn->setXmlSpecificityFile(argv[3]);
+      dyn->setXmlRankFile(argv[4]);
+      dyn->setVrmlMainFile(argv[2]);
+
+      dyn->parseConfigFiles();
+    }
+  catch (ExceptionDynamic& e)
+    {
+      if ( !strcmp(e.what(), "Error while parsing." )) {
+	cout << "Could not locate the necessary files for this test" << endl;
+	return 77;
+      }
+      else
+	// rethrow
+	throw e;
+    }
+
+  const unsigned int NBDOF = dyn->m_HDR->numberDof();
+  vectorN q(NBDOF);
+  for( unsigned int i=0;i<NBDOF;++i ) q(i) = 0.01*i;
+  dyn->m_HDR->currentConfiguration(q);
+  dyn->m_HDR->computeForwardKinematics();
+
+  const std::vector<CjrlJoint*> joints = dyn->m_HDR->jointVector();
+  const unsigned int NBJOINTS = joints.size();
+  std::vector<double> corrections( 9*NBJOINTS );
+  for( unsigned int j=0;j<NBJOINTS;++j )
+    DynamicAccess::computeFrameCorrection( joints[j],&corrections[9*j] );
+
+  /* Both computations must agree. */
+  MatrixHomogeneous legacy,fused;
+  double err = 0.;
+  for( unsigned int j=0;j<NBJOINTS;++j )
+    {
+      legacyJointPosition( joints[j],legacy );
+      DynamicAccess::composeJointPosition( joints[j]->currentTransformation(),
+					  &corrections[9*j],fused );
+      for( unsigned int r=0;r<4;++r )
+	for( unsigned int c=0;c<4;++c )
+	  err += std::fabs( legacy(r,c)-fused(r,c) );
+    }
+  if( err>1e-12 )
+    {
+      cerr << "Cached frame correction differs from the legacy one: "
+	   << err << endl;
+      return 1;
+    }
+
+  /* The parallel mode must give the same signals as the serial one. */
+  ml::Vector position(NBDOF);
+  for( unsigned int i=0;i<NBDOF;++i ) position(i) = q(i);
+  Signal<ml::Vector,int> positionSignal("position");
+  positionSignal.setConstant(position);
+  dyn->jointPositionSIN.plug(&positionSignal);
+
+  std::vector< SignalTimeDependent<MatrixHomogeneous,int>* > positions;
+  std::vector< SignalTimeDependent<ml::Matrix,int>* > jacobians;
+  for( unsigned int j=0;j<NBJOINTS;++j )
+    {
+      std::ostringstream oss; oss << j;
+      positions.push_back( &dyn->createPositionSignal( "p"+oss.str(),joints[j] ) );
+      jacobians.push_back( &dyn->createEndeffJacobianSignal( "J"+oss.str(),joints[j] ) );
+    }
+  std::vector<MatrixHomogeneous> serialPositions( NBJOINTS );
+  std::vector<ml::Matrix> serialJacobians( NBJOINTS );
+  for( unsigned int j=0;j<NBJOINTS;++j )
+    {
+      serialPositions[j] = (*positions[j])(1);
+      serialJacobians[j] = (*jacobians[j])(1);
+    }
+
+  dyn->setParallelSignals(2);
+  err = 0.;
+  for( unsigned int j=NBJOINTS;j-->0; )
+    {
+      const MatrixHomogeneous& M = (*positions[j])(2);
+      const ml::Matrix& J = (*jacobians[j])(2);
+      for( unsigned int r=0;r<4;++r )
+	for( unsigned int c=0;c<4;++c )
+	  err += std::fabs( M(r,c)-serialPositions[j](r,c) );
+      for( unsigned int r=0;r<J.nbRows();++r )
+	for( unsigned int c=0;c<J.nbCols();++c )
+	  err += std::fabs( J(r,c)-serialJacobians[j](r,c) );
+    }
+  if( err>0. )
+    {
+      cerr << "Parallel joint signals differ from the serial ones: "
+	   << err << endl;
+      return 1;
+    }
+
+  delete dyn;
+  return 0;
+}
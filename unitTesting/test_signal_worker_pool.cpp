@@ -0,0 +1,86 @@
+/*
+ * Copyright 2010,
+ * François Bleibel,
+ * Olivier Stasse,
+ *
+ * CNRS/AIST
+ *
+ * This file is part of sot-dynamic.
+ * sot-dynamic is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ * sot-dynamic is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.  You should
+ * have received a copy of the GNU Lesser General Public License along
+ * with sot-dynamic.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- INCLUDES ------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+#include "signal-worker-pool.h"
+#include <boost/bind.hpp>
+#include <iostream>
+#include <stdexcept>
+
+using namespace std;
+using namespace dynamicgraph::sot;
+
+static void writeSlot( std::vector<int>* slots,unsigned int index,int time )
+{
+  (*slots)[index] = time+int(index);
+}
+
+static void throwAt( unsigned int index,int time )
+{
+  if( time==int(index) ) throw std::runtime_error( "task failure" );
+}
+
+/* Every task of every batch runs once, with the time of its batch, and an
+ * exception in a task is reported by run. */
+int main (int , char** )
+{
+  const unsigned int NB_BATCHES = 1000;
+  const unsigned int NB_TASKS = 100;
+
+  SignalWorkerPool pool( 3 );
+  std::vector<int> slots( NB_TASKS );
+  std::vector<SignalWorkerPool::Task> tasks;
+  for( unsigned int i=0;i<NB_TASKS;++i )
+    tasks.push_back( boost::bind( &writeSlot,&slots,i,_1 ) );
+
+  std::string error;
+  for( unsigned int n=0;n<NB_BATCHES;++n )
+    {
+      const int time = int(n)*NB_TASKS;
+      if(! pool.run( tasks,time,error ) )
+	{
+	  cerr << "Batch " << n << " failed: " << error << endl;
+	  return 1;
+	}
+      for( unsigned int i=0;i<NB_TASKS;++i )
+	if( slots[i]!=time+int(i) )
+	  {
+	    cerr << "Task " << i << " of batch " << n << " not run." << endl;
+	    return 1;
+	  }
+    }
+
+  std::vector<SignalWorkerPool::Task> failing;
+  for( unsigned int i=0;i<NB_TASKS;++i )
+    failing.push_back( boost::bind( &throwAt,i,_1 ) );
+  if( pool.run( failing,7,error )||(error!="task failure") )
+    {
+      cerr << "Task failure not reported." << endl;
+      return 1;
+    }
+  if(! pool.run( tasks,0,error ) )
+    {
+      cerr << "Pool not usable after a task failure." << endl;
+      return 1;
+    }
+  return 0;
+}
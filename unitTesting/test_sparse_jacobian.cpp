@@ -0,0 +1,89 @@
+/*
+ * Copyright 2010,
+ * François Bleibel,
+ * Olivier Stasse,
+ *
+ * CNRS/AIST
+ *
+ * This file is part of sot-dynamic.
+ * sot-dynamic is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ * sot-dynamic is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.  You should
+ * have received a copy of the GNU Lesser General Public License along
+ * with sot-dynamic.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* -------------------------------------------------------------------------- */
+/* --- INCLUDES ------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+#include <sot-dynamic/sparse-jacobian.h>
+#include <iostream>
+#include <cmath>
+
+using namespace std;
+using namespace dynamicgraph::sot;
+
+/* Compare the sparse helpers with the dense products on a random jacobian
+ * whose columns outside the support are zero. */
+int main (int , char** )
+{
+  const unsigned int NBCOLS = 12;
+  std::vector<unsigned int> support;
+  support.push_back(0); support.push_back(3);
+  support.push_back(4); support.push_back(9);
+
+  SparseJacobian J;
+  J.setSupport( 6,NBCOLS,support );
+  for( unsigned int i=0;i<6;++i )
+    for( unsigned int k=0;k<support.size();++k )
+      J.compact()(i,k) = std::cos( double(i*7+k) );
+
+  ml::Matrix dense; J.toDense( dense );
+  ml::Vector dq(NBCOLS),f(6);
+  for( unsigned int i=0;i<NBCOLS;++i ) dq(i) = std::sin( double(i) );
+  for( unsigned int i=0;i<6;++i ) f(i) = 1.+i;
+
+  ml::Vector Jdq,Jtf;
+  J.multiply( dq,Jdq );
+  J.transposeMultiply( f,Jtf );
+  ml::Vector Jdq_ref,Jtf_ref;
+  Jdq_ref.resize(6); Jtf_ref.resize(NBCOLS);
+  for( unsigned int i=0;i<6;++i )
+    for( unsigned int j=0;j<NBCOLS;++j )
+      {
+	Jdq_ref(i) += dense(i,j)*dq(j);
+	Jtf_ref(j) += dense(i,j)*f(i);
+      }
+
+  /* A reused result keeps no value outside the support. */
+  ml::Vector Jtf_reused(NBCOLS);
+  Jtf_reused.fill(100.);
+  J.transposeMultiply( f,Jtf_reused );
+
+  ml::Matrix stack; stack.resize(12,NBCOLS);
+  J.stackInto( stack,0 ); J.stackInto( stack,6 );
+
+  double err = 0.;
+  for( unsigned int i=0;i<6;++i )
+    err += std::fabs( Jdq(i)-Jdq_ref(i) );
+  for( unsigned int i=0;i<NBCOLS;++i )
+    err += std::fabs( Jtf(i)-Jtf_ref(i) )
+      + std::fabs( Jtf_reused(i)-Jtf_ref(i) );
+  for( unsigned int i=0;i<6;++i )
+    for( unsigned int j=0;j<NBCOLS;++j )
+      err += std::fabs( stack(i,j)-dense(i,j) )
+	+ std::fabs( stack(i+6,j)-dense(i,j) );
+
+  if( err>1e-12 )
+    {
+      cerr << "Sparse jacobian products differ from dense ones: " << err << endl;
+      return 1;
+    }
+  return 0;
+}
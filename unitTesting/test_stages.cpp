@@ -0,0 +1,129 @@
+/*
+ * Copyright 2010,
+ * François Bleibel,
+ * Olivier Stasse,
+ *
+ * CNRS/AIST
+ *
+ * This file is part of sot-dynamic.
+ * sot-dynamic is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ * sot-dynamic is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.  You should
+ * have received a copy of the GNU Lesser General Public License along
+ * with sot-dynamic.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* -------------------------------------------------------------------------- */
+/* --- INCLUDES ------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+#include <sot-dynamic/dynamic.h>
+#include <dynamic-graph/signal.h>
+#include <iostream>
+#include <cstring>
+#include <cmath>
+
+using namespace std;
+using namespace dynamicgraph;
+using namespace dynamicgraph::sot;
+
+static double distance( const MatrixHomogeneous& a,const MatrixHomogeneous& b )
+{
+  double err = 0;
+  for( unsigned int i=0;i<4;++i )
+    for( unsigned int j=0;j<4;++j )
+      err = std::max( err,std::fabs( a(i,j)-b(i,j) ) );
+  return err;
+}
+
+int main(int argc, char * argv[])
+{
+  if (argc!=5)
+    {
+      cerr << "Usage:" << endl;
+      cerr << "./" << argv[0] << " DIR_OF_VRML_MODEL VRML_MODEL_FILENAME PATH_TO_SPECIFICITIES_FILE PATH_TO_LINK2JOINT_FILE " << endl;
+      return 1;
+    }
+  Dynamic * dyn = new Dynamic("tot");
+  try
+    {
+      dyn->setVrmlDirectory(argv[1]);
+      dyn->setXmlSpecificityFile(argv[3]);
+      dyn->setXmlRankFile(argv[4]);
+      dyn->setVrmlMainFile(argv[2]);
+
+      dyn->parseConfigFiles();
+    }
+  catch (ExceptionDynamic& e)
+    {
+      if ( !strcmp(e.what(), "Error while parsing." )) {
+	cout << "Could not locate the necessary files for this test" << endl;
+	return 77;
+      }
+      else
+	// rethrow
+	throw e;
+    }
+
+  const unsigned int NBDOF = dyn->m_HDR->numberDof();
+  ml::Vector q(NBDOF),dq(NBDOF),ddq(NBDOF),ff(6);
+  for( unsigned int i=0;i<NBDOF;++i )
+    { q(i) = 0.01*i; dq(i) = 0.1; ddq(i) = -0.1; }
+  for( unsigned int i=0;i<6;++i ) ff(i) = 0.2;
+
+  Signal<ml::Vector,int> position("position");
+  Signal<ml::Vector,int> velocity("velocity");
+  Signal<ml::Vector,int> acceleration("acceleration");
+  Signal<ml::Vector,int> ffposition("ffposition");
+  position.setConstant(q);
+  velocity.setConstant(dq);
+  acceleration.setConstant(ddq);
+  ffposition.setConstant(ff);
+  dyn->jointPositionSIN.plug(&position);
+  dyn->jointVelocitySIN.plug(&velocity);
+  dyn->jointAccelerationSIN.plug(&acceleration);
+  dyn->freeFlyerPositionSIN.plug(&ffposition);
+
+  CjrlJoint* joint = dyn->m_HDR->jointVector().back();
+  SignalTimeDependent<MatrixHomogeneous,int>& pos
+    = dyn->createPositionSignal( "endPosition",joint );
+
+  /* A kinematic read, then a dynamic read at the same time. */
+  int time = 1;
+  const MatrixHomogeneous before = pos(time);
+  dyn->zmpSOUT(time);
+
+  /* Modify the inputs and recompute the graph at the same time: the stage
+   * must not be served from the previous inputs. */
+  for( unsigned int i=0;i<NBDOF;++i ) q(i) += 0.1;
+  ff(0) += 0.1;
+  position.setConstant(q);
+  ffposition.setConstant(ff);
+  dyn->kinematicsSINTERN.setReady();
+  pos.setReady();
+  const MatrixHomogeneous after = pos(time);
+
+  /* Reference: the same inputs at a new time. */
+  const MatrixHomogeneous reference = pos(time+1);
+
+  if( distance(before,after)<1e-6 )
+    {
+      cerr << "Position not updated after an input change at time "
+	   << time << "." << endl;
+      return 1;
+    }
+  const double err = distance(after,reference);
+  if( err>1e-12 )
+    {
+      cerr << "Position recomputed at time " << time << " differs from "
+	   << "the reference by " << err << "." << endl;
+      return 1;
+    }
+
+  delete dyn;
+  return 0;
+}